@@ -1,18 +1,97 @@
 #include <iostream>
 #include <unordered_map>
 #include <string>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <thread>
+#include <mutex>
+#include <deque>
+#include <functional>
+#include <sstream>
+#include <algorithm>
+#include <queue>
+#include <cmath>
+#include <iomanip>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 using namespace std;
 
 /**
- * Node of Doubly Linked List
+ * Replacement policy used inside each set of a SetAssociativeCache
  */
-struct DLLNode
+enum SetPolicy
+{
+    SET_LRU,
+    SET_FIFO,
+    SET_RANDOM,
+    SET_PLRU // tree pseudo-LRU
+};
+
+/**
+ * Size, associativity and policy of one level of a TLB hierarchy
+ */
+struct LevelConfig
+{
+    uint32_t entries;
+    uint32_t ways;
+    SetPolicy policy;
+};
+
+/**
+ * Command line options
+ */
+struct Options
+{
+    bool allK;               // print LRU and Optimal hit counts for every TLB size 1..K
+    bool parallel;           // run the simulations of a test case on separate threads
+    bool batch;              // read all test cases first, then run them on a thread pool
+    uint32_t jobs;           // thread pool size in batch mode (0 = number of cores)
+    uint32_t ways;           // simulate a set-associative TLB with this many ways (0 = fully associative)
+    bool hierarchy;          // simulate the L1/L2 hierarchy given by l1 and l2 instead of a single TLB
+    LevelConfig l1;          // L1 dTLB
+    LevelConfig l2;          // unified L2 STLB
+    bool exclusive;          // exclusive (victim) L2 instead of inclusive
+    const char *pageMapPath; // regions with their own page size (NULL = P everywhere)
+    bool splitTLB;           // separate TLB of K entries per page size instead of one unified TLB
+    bool asid;               // input entries carry ASID tags and context-switch markers
+    bool asidFlush;          // flush all TLBs on a context switch instead of keeping tagged entries
+    double shardsRate;       // estimate the LRU miss-ratio curve from this fraction of pages (0 = off)
+    uint32_t shardsMax;      // with shardsRate, track at most this many pages (0 = fixed rate)
+    bool tinyLFULRU;         // W-TinyLFU main region is plain LRU instead of SLRU
+    bool stream;             // simulate while reading in chunks instead of loading whole test cases
+    uint32_t window;         // lookahead of the streaming Optimal simulation, in references
+    vector<uint32_t> gridS;  // simulate every test case for each of these S (in MB) ...
+    vector<uint32_t> gridP;  // ... and each of these P (in KB); empty = the test case's own value
+    const char *convertPath; // convert input to .tlbtrace at this path instead of simulating
+    const char *statsPath;   // write reuse-distance, working-set and hit-rate statistics here (NULL = off)
+    bool statsJSON;          // statistics as a JSON array instead of CSV rows
+    uint32_t statsInterval;  // references per point of the working-set and hit-rate time series
+    vector<uint32_t> statsWindows; // working-set windows tau, in references
+    Options() : allK(false), parallel(false), batch(false), jobs(0), ways(0), hierarchy(false), exclusive(false),
+                pageMapPath(NULL), splitTLB(false), asid(false), asidFlush(false),
+                shardsRate(0), shardsMax(0), tinyLFULRU(false), stream(false), window(1 << 20), convertPath(NULL),
+                statsPath(NULL), statsJSON(false), statsInterval(10000), statsWindows({1000, 10000, 100000}) {}
+};
+
+Options options;
+
+/**
+ * Slot of index-linked Doubly Linked List
+ */
+struct DLLSlot
 {
     uint32_t data;
-    DLLNode *next;
-    DLLNode *prev;
-    DLLNode(uint32_t data) : data(data), next(NULL), prev(NULL) {}
+    uint32_t next; // slot index of next node
+    uint32_t prev; // slot index of previous node
 };
 
 /**
@@ -27,597 +106,4937 @@ struct HeapNode
 };
 
 /**
- * FIFO Cache Implementation
+ * Fenwick Tree (Binary Indexed Tree) over positions 0..n-1
  */
-class FIFOCache
+class FenwickTree
 {
 private:
-    uint32_t *arr;
-    uint32_t size;
-    uint32_t capacity;
-    uint32_t front;
-    uint32_t rear;
-    unordered_map<uint32_t, uint32_t> count; // using as set to check if element exist in cache
+    vector<int32_t> tree;
+
+public:
+    /**
+     * Constructor
+     */
+    FenwickTree(uint32_t n) : tree(n + 1, 0) {}
 
     /**
-     * Evict element from Cache according to FIFO policy
+     * Add delta at position idx
      */
-    void evictElementFromCache()
+    void add(uint32_t idx, int32_t delta)
     {
-        // remove first element
-        if (size == 0)
-            return;
-        count.erase(arr[front]);
-        front = (front + 1) % capacity;
-        size--;
+        for (uint32_t i = idx + 1; i < tree.size(); i += i & (-i))
+        {
+            tree[i] += delta;
+        }
+    }
+
+    /**
+     * Sum of positions 0..idx-1
+     */
+    int32_t prefixSum(uint32_t idx)
+    {
+        int32_t sum = 0;
+        for (uint32_t i = idx; i > 0; i -= i & (-i))
+        {
+            sum += tree[i];
+        }
+        return sum;
+    }
+};
+
+/**
+ * Open-addressing hash set of uint32_t with linear probing
+ *
+ * The table is a power of two at least twice the maximum number of elements, so probe
+ * runs stay within one or two cache lines. Erase shifts later elements of the run back
+ * instead of leaving tombstones. EMPTY marks a free slot, so the key EMPTY itself is
+ * tracked by a separate flag.
+ */
+class FlatHashSet
+{
+private:
+    static const uint32_t EMPTY = 0xFFFFFFFF;
+    uint32_t *slots;
+    uint32_t mask;
+    uint32_t shift;
+    bool hasEmptyKey;
+
+    /**
+     * Home slot of key (Fibonacci hashing)
+     */
+    uint32_t home(uint32_t key) const
+    {
+        return (uint32_t)(key * 2654435769u) >> shift;
+    }
+
+    /**
+     * Slot holding key, or the free slot ending its probe run
+     */
+    uint32_t findSlot(uint32_t key) const
+    {
+        uint32_t i = home(key);
+        while (slots[i] != key && slots[i] != EMPTY)
+        {
+            i = (i + 1) & mask;
+        }
+        return i;
     }
 
 public:
     /**
      * Constructor
      */
-    FIFOCache(uint32_t capacity) : capacity(capacity), size(0), front(0), rear(0)
+    FlatHashSet(uint32_t maxSize) : hasEmptyKey(false)
     {
-        arr = new uint32_t[capacity];
-        count.clear();
+        uint32_t bits = 3;
+        while (bits < 31 && (1u << bits) < 2 * (uint64_t)maxSize)
+        {
+            bits++;
+        }
+        mask = (1u << bits) - 1;
+        shift = 32 - bits;
+        slots = new uint32_t[mask + 1];
+        memset(slots, 0xFF, (mask + 1) * sizeof(uint32_t));
     }
 
     /**
-     * Check if element is in Cache
+     * Check if key is in set
      */
-    bool checkInCache(uint32_t data)
+    bool contains(uint32_t key) const
     {
-        return count.find(data) != count.end();
+        if (key == EMPTY)
+            return hasEmptyKey;
+        return slots[findSlot(key)] == key;
     }
 
     /**
-     * Insert element in Cache
+     * Insert key in set
      */
-    void insertElementInCache(uint32_t data)
+    void insert(uint32_t key)
     {
-        if (size == capacity)
+        if (key == EMPTY)
         {
-            evictElementFromCache();
+            hasEmptyKey = true;
+            return;
         }
-        arr[rear] = data;
-        rear = (rear + 1) % capacity;
-        size++;
-        count[data] = 1;
+        slots[findSlot(key)] = key;
+    }
+
+    /**
+     * Erase key from set
+     */
+    void erase(uint32_t key)
+    {
+        if (key == EMPTY)
+        {
+            hasEmptyKey = false;
+            return;
+        }
+        uint32_t i = findSlot(key);
+        if (slots[i] == EMPTY)
+            return;
+        // shift back elements whose probe run passes through the freed slot
+        for (uint32_t j = (i + 1) & mask; slots[j] != EMPTY; j = (j + 1) & mask)
+        {
+            if (((j - home(slots[j])) & mask) >= ((j - i) & mask))
+            {
+                slots[i] = slots[j];
+                i = j;
+            }
+        }
+        slots[i] = EMPTY;
     }
 
     /**
      * Destructor
      */
-    ~FIFOCache()
+    ~FlatHashSet()
     {
-        delete[] arr;
+        delete[] slots;
     }
 };
 
 /**
- * LIFO Cache Implementation
+ * Open-addressing hash map from uint32_t to uint32_t with linear probing
+ *
+ * Same layout as FlatHashSet with the value stored next to its key, so a lookup reads
+ * a single cache line in the common case.
  */
-class LIFOCache
+class FlatHashMap
 {
 private:
-    uint32_t *arr;
-    uint32_t size;
-    uint32_t capacity;
-    unordered_map<uint32_t, uint32_t> count; // using as set to check if element exist in cache
+    static const uint32_t EMPTY = 0xFFFFFFFF;
+    struct Entry
+    {
+        uint32_t key;
+        uint32_t value;
+    };
+    Entry *slots;
+    uint32_t mask;
+    uint32_t shift;
+    bool hasEmptyKey;
+    uint32_t emptyKeyValue;
 
     /**
-     * Evict element from Cache according to LIFO policy
+     * Home slot of key (Fibonacci hashing)
      */
-    void evictElementFromCache()
+    uint32_t home(uint32_t key) const
     {
-        // remove last element
-        if (size == 0)
-            return;
-        count.erase(arr[size - 1]);
-        size--;
+        return (uint32_t)(key * 2654435769u) >> shift;
+    }
+
+    /**
+     * Slot holding key, or the free slot ending its probe run
+     */
+    uint32_t findSlot(uint32_t key) const
+    {
+        uint32_t i = home(key);
+        while (slots[i].key != key && slots[i].key != EMPTY)
+        {
+            i = (i + 1) & mask;
+        }
+        return i;
     }
 
 public:
+    static const uint32_t NOT_FOUND = 0xFFFFFFFF;
+
     /**
      * Constructor
      */
-    LIFOCache(uint32_t capacity) : capacity(capacity), size(0)
+    FlatHashMap(uint32_t maxSize) : hasEmptyKey(false), emptyKeyValue(NOT_FOUND)
     {
-        arr = new uint32_t[capacity];
-        count.clear();
+        uint32_t bits = 3;
+        while (bits < 31 && (1u << bits) < 2 * (uint64_t)maxSize)
+        {
+            bits++;
+        }
+        mask = (1u << bits) - 1;
+        shift = 32 - bits;
+        slots = new Entry[mask + 1];
+        memset(slots, 0xFF, (mask + 1) * sizeof(Entry));
     }
 
     /**
-     * Check if element is in Cache
+     * Value of key, NOT_FOUND if key is not in map
      */
-    bool checkInCache(uint32_t data)
+    uint32_t find(uint32_t key) const
     {
-        return count.find(data) != count.end();
+        if (key == EMPTY)
+            return hasEmptyKey ? emptyKeyValue : NOT_FOUND;
+        const Entry &e = slots[findSlot(key)];
+        return e.key == key ? e.value : NOT_FOUND;
     }
 
     /**
-     * Insert element in Cache
+     * Insert or update key with value
      */
-    void insertElementInCache(uint32_t data)
+    void insert(uint32_t key, uint32_t value)
     {
-        if (size == capacity)
+        if (key == EMPTY)
         {
-            evictElementFromCache();
+            hasEmptyKey = true;
+            emptyKeyValue = value;
+            return;
         }
-        arr[size] = data;
-        size++;
-        count[data] = 1;
+        Entry &e = slots[findSlot(key)];
+        e.key = key;
+        e.value = value;
+    }
+
+    /**
+     * Erase key from map
+     */
+    void erase(uint32_t key)
+    {
+        if (key == EMPTY)
+        {
+            hasEmptyKey = false;
+            return;
+        }
+        uint32_t i = findSlot(key);
+        if (slots[i].key == EMPTY)
+            return;
+        // shift back entries whose probe run passes through the freed slot
+        for (uint32_t j = (i + 1) & mask; slots[j].key != EMPTY; j = (j + 1) & mask)
+        {
+            if (((j - home(slots[j].key)) & mask) >= ((j - i) & mask))
+            {
+                slots[i] = slots[j];
+                i = j;
+            }
+        }
+        slots[i].key = EMPTY;
     }
 
     /**
      * Destructor
      */
-    ~LIFOCache()
+    ~FlatHashMap()
     {
-        delete[] arr;
+        delete[] slots;
     }
 };
 
 /**
- * LRU Cache Implementation
+ * Pool of slots linked into a fixed number of index-linked lists
+ *
+ * Slots 0..capacity-1 hold elements and slot capacity + l is the sentinel of list l;
+ * one extra list holds the free slots. Moving an element between lists is a few index
+ * writes and nothing is allocated after construction. Elements are appended at the
+ * back and taken from the front.
  */
-class LRUCache
+class SlotLists
 {
 private:
-    DLLNode *front; // placeholder node for front
-    DLLNode *rear;  // placeholder node for rear
-    uint32_t size;
+    DLLSlot *slots;
+    uint8_t *owner; // list of each slot
+    uint32_t *sizes;
     uint32_t capacity;
-    unordered_map<uint32_t, DLLNode *> mp;
+    uint32_t freeList; // list of unused slots
 
     /**
-     * Insert node at front of DLL
+     * Unlink slot from its list
      */
-    void insertAtFront(DLLNode *node)
+    void unlink(uint32_t slot)
     {
-        node->next = front->next;
-        node->prev = front;
-        front->next->prev = node;
-        front->next = node;
-        size++;
+        slots[slots[slot].prev].next = slots[slot].next;
+        slots[slots[slot].next].prev = slots[slot].prev;
+        sizes[owner[slot]]--;
     }
 
     /**
-     * Delete node from DLL
+     * Link slot at back of list
      */
-    void deleteNode(DLLNode *node)
+    void link(uint32_t list, uint32_t slot)
     {
-        node->prev->next = node->next;
-        node->next->prev = node->prev;
-        size--;
+        uint32_t sentinel = capacity + list;
+        slots[slot].next = sentinel;
+        slots[slot].prev = slots[sentinel].prev;
+        slots[slots[sentinel].prev].next = slot;
+        slots[sentinel].prev = slot;
+        owner[slot] = list;
+        sizes[list]++;
     }
 
+public:
     /**
-     * Delete node from rear of DLL
+     * Constructor
      */
-    DLLNode *deleteAtRear()
+    SlotLists(uint32_t capacity, uint32_t lists) : capacity(capacity), freeList(lists)
     {
-        DLLNode *node = rear->prev;
-        deleteNode(node);
-        return node;
+        slots = new DLLSlot[capacity + lists + 1];
+        owner = new uint8_t[capacity];
+        sizes = new uint32_t[lists + 1];
+        for (uint32_t l = 0; l <= lists; l++)
+        {
+            slots[capacity + l].next = capacity + l;
+            slots[capacity + l].prev = capacity + l;
+            sizes[l] = 0;
+        }
+        for (uint32_t slot = 0; slot < capacity; slot++)
+        {
+            link(freeList, slot);
+        }
     }
 
     /**
-     * Evict element from Cache according to LRU policy
+     * Take a free slot for data and append it to list
      */
-    void evictElementFromCache()
+    uint32_t add(uint32_t list, uint32_t data)
     {
-        if (size == 0)
-            return;
-        DLLNode *node = deleteAtRear();
-        mp.erase(node->data);
-        delete node;
+        uint32_t slot = front(freeList);
+        moveToBack(list, slot);
+        slots[slot].data = data;
+        return slot;
     }
 
-public:
     /**
-     * Constructor
+     * Return slot to the free slots
      */
-    LRUCache(uint32_t capacity) : capacity(capacity), size(0)
+    void remove(uint32_t slot)
     {
-        front = new DLLNode(-1);
-        rear = new DLLNode(-1);
-        front->next = rear;
-        rear->prev = front;
-        mp.clear();
+        moveToBack(freeList, slot);
     }
 
     /**
-     * Check if element is in Cache
+     * Move slot to back of list
      */
-    bool checkInCache(uint32_t data)
+    void moveToBack(uint32_t list, uint32_t slot)
     {
-        if (mp.find(data) == mp.end())
-            return false;
-        DLLNode *node = mp[data];
-        deleteNode(node);
-        insertAtFront(node);
-        return true;
+        unlink(slot);
+        link(list, slot);
     }
 
     /**
-     * Insert element in Cache
+     * First slot of list (a sentinel if list is empty)
      */
-    void insertElementInCache(uint32_t data)
+    uint32_t front(uint32_t list) const
     {
-        if (size == capacity)
-        {
-            evictElementFromCache();
-        }
-        DLLNode *node = new DLLNode(data);
-        insertAtFront(node);
-        mp[data] = node;
+        return slots[capacity + list].next;
+    }
+
+    /**
+     * Number of slots in list
+     */
+    uint32_t size(uint32_t list) const
+    {
+        return sizes[list];
+    }
+
+    /**
+     * List holding slot
+     */
+    uint32_t listOf(uint32_t slot) const
+    {
+        return owner[slot];
+    }
+
+    /**
+     * Element held by slot
+     */
+    uint32_t data(uint32_t slot) const
+    {
+        return slots[slot].data;
     }
 
     /**
      * Destructor
      */
-    ~LRUCache()
+    ~SlotLists()
     {
-        while (front != NULL)
-        {
-            DLLNode *temp = front;
-            front = front->next;
-            delete temp;
-        }
+        delete[] slots;
+        delete[] owner;
+        delete[] sizes;
     }
 };
 
 /**
- * Optimal Cache Implementation
+ * Doubly linked list of slot indices 0..capacity-1 with its own link arrays
+ *
+ * Unlike SlotLists, a slot can be in several IndexLists at once (one link pair per
+ * list), which LIRS needs for blocks that are both on its stack and on its queue.
  */
-class OptimalCache
+class IndexList
 {
 private:
-    HeapNode *arr; // array representation of heap
-    uint32_t capacity;
-    uint32_t size;
-    unordered_map<uint32_t, uint32_t> mp; // to store index of element in heap array
+    static const uint32_t UNLINKED = 0xFFFFFFFF;
+    uint32_t *next;
+    uint32_t *prev;
+    uint32_t capacity; // next[capacity] / prev[capacity] is the sentinel
+    uint32_t count;
 
+public:
     /**
-     * Upheap operation
+     * Constructor
      */
-    void upHeap(int idx)
+    IndexList(uint32_t capacity) : capacity(capacity), count(0)
     {
-        while (idx > 0)
-        {
-            int parent = (idx - 1) / 2;
-            if (arr[parent].key < arr[idx].key)
-            {
-                swap(arr[parent], arr[idx]);
-                mp[arr[parent].value] = parent;
-                mp[arr[idx].value] = idx;
-                idx = parent;
-            }
-            else
-            {
-                break;
-            }
-        }
+        next = new uint32_t[capacity + 1];
+        prev = new uint32_t[capacity + 1];
+        memset(next, 0xFF, capacity * sizeof(uint32_t));
+        next[capacity] = prev[capacity] = capacity;
     }
 
     /**
-     * Downheap operation
+     * Check if slot is in list
      */
-    void downHeap(int idx)
+    bool contains(uint32_t slot) const
     {
-        while (2 * idx + 1 < size)
-        {
-            int left = 2 * idx + 1;
-            int right = 2 * idx + 2;
-            int largest = idx;
-            if (left < size && arr[left].key > arr[largest].key)
-            {
-                largest = left;
-            }
-            if (right < size && arr[right].key > arr[largest].key)
-            {
-                largest = right;
-            }
-            if (largest != idx)
-            {
-                swap(arr[largest], arr[idx]);
-                mp[arr[largest].value] = largest;
-                mp[arr[idx].value] = idx;
-                idx = largest;
-            }
-            else
-            {
-                break;
-            }
-        }
+        return next[slot] != UNLINKED;
     }
 
     /**
-     * Evict element from Cache according to Optimal policy
+     * Append slot at back of list
      */
-    void eviceElementFromCache()
+    void pushBack(uint32_t slot)
     {
-        if (size == 0)
-            return;
-        mp.erase(arr[0].value);
-        size--;
-        arr[0] = arr[size];
-        mp[arr[0].value] = 0;
-        downHeap(0);
+        next[slot] = capacity;
+        prev[slot] = prev[capacity];
+        next[prev[capacity]] = slot;
+        prev[capacity] = slot;
+        count++;
     }
 
-public:
     /**
-     * Constructor
+     * Remove slot from list
      */
-    OptimalCache(uint32_t capacity) : capacity(capacity), size(0)
+    void remove(uint32_t slot)
     {
-        arr = new HeapNode[capacity];
-        mp.clear();
+        next[prev[slot]] = next[slot];
+        prev[next[slot]] = prev[slot];
+        next[slot] = UNLINKED;
+        count--;
     }
 
     /**
-     * Check if element is in Cache
+     * Move slot (in list) to back of list
      */
-    bool checkInCache(uint32_t data)
+    void moveToBack(uint32_t slot)
     {
-        return mp.find(data) != mp.end();
+        remove(slot);
+        pushBack(slot);
     }
 
     /**
-     * Insert element in Cache
+     * First slot of list
      */
-    void insertElementInCache(uint32_t key, uint32_t value)
+    uint32_t front() const
     {
-        if (size == capacity)
-        {
-            eviceElementFromCache();
-        }
-        arr[size] = HeapNode(key, value);
-        mp[value] = size;
-        upHeap(size);
-        size++;
+        return next[capacity];
     }
 
     /**
-     * Modify key of element in Cache
+     * Number of slots in list
      */
-    void modifyKey(uint32_t value, uint32_t key)
+    uint32_t size() const
     {
-        if (mp.find(value) == mp.end())
-            return;
-        int idx = mp[value];
-        arr[idx].key = key;
-        upHeap(idx);
-        downHeap(idx);
+        return count;
     }
 
     /**
      * Destructor
      */
-    ~OptimalCache()
+    ~IndexList()
     {
-        delete[] arr;
+        delete[] next;
+        delete[] prev;
     }
 };
 
 /**
- * Returns true if n is power of 2
+ * FIFO Cache Implementation
  */
-bool isPowerOfTwo(uint32_t n)
+class FIFOCache
 {
-    return (n & (n - 1)) == 0;
-}
+private:
+    uint32_t *arr;
+    uint32_t size;
+    uint32_t capacity;
+    uint32_t front;
+    uint32_t rear;
+    FlatHashSet count; // set of elements in cache
 
-/**
- * Return which power of 2 is n
- */
-uint32_t getPowerOfTwo(uint32_t n)
-{
-    uint32_t p = 0;
-    while (n > 1)
+public:
+    /**
+     * Constructor
+     */
+    FIFOCache(uint32_t capacity) : capacity(capacity), size(0), front(0), rear(0), count(capacity)
     {
-        n = n >> 1;
-        p++;
+        arr = new uint32_t[capacity];
     }
-    return p;
-}
 
-/**
- * Parse Hexadecimal string address to uint32_t
- */
-uint32_t parseHex(string &s)
-{
-    uint32_t ans = 0;
-    for (char c : s)
+    /**
+     * Check if element is in Cache
+     */
+    bool lookup(uint32_t data)
     {
-        uint32_t t = c - '0';
-        if (t >= 10)
-        {
-            t = c - 'A' + 10;
+        return count.contains(data);
+    }
+
+    /**
+     * Update state on a hit (FIFO order ignores hits)
+     */
+    void touch(uint32_t data, uint32_t i) {}
+
+    /**
+     * Evict element from Cache according to FIFO policy
+     */
+    void evict()
+    {
+        // remove first element
+        if (size == 0)
+            return;
+        count.erase(arr[front]);
+        front = (front + 1) % capacity;
+        size--;
+    }
+
+    /**
+     * Insert element in Cache
+     */
+    void insert(uint32_t data, uint32_t i)
+    {
+        if (size == capacity)
+        {
+            evict();
+        }
+        arr[rear] = data;
+        rear = (rear + 1) % capacity;
+        size++;
+        count.insert(data);
+    }
+
+    /**
+     * Destructor
+     */
+    ~FIFOCache()
+    {
+        delete[] arr;
+    }
+};
+
+/**
+ * LIFO Cache Implementation
+ */
+class LIFOCache
+{
+private:
+    uint32_t *arr;
+    uint32_t size;
+    uint32_t capacity;
+    FlatHashSet count; // set of elements in cache
+
+public:
+    /**
+     * Constructor
+     */
+    LIFOCache(uint32_t capacity) : capacity(capacity), size(0), count(capacity)
+    {
+        arr = new uint32_t[capacity];
+    }
+
+    /**
+     * Check if element is in Cache
+     */
+    bool lookup(uint32_t data)
+    {
+        return count.contains(data);
+    }
+
+    /**
+     * Update state on a hit (LIFO order ignores hits)
+     */
+    void touch(uint32_t data, uint32_t i) {}
+
+    /**
+     * Evict element from Cache according to LIFO policy
+     */
+    void evict()
+    {
+        // remove last element
+        if (size == 0)
+            return;
+        count.erase(arr[size - 1]);
+        size--;
+    }
+
+    /**
+     * Insert element in Cache
+     */
+    void insert(uint32_t data, uint32_t i)
+    {
+        if (size == capacity)
+        {
+            evict();
+        }
+        arr[size] = data;
+        size++;
+        count.insert(data);
+    }
+
+    /**
+     * Destructor
+     */
+    ~LIFOCache()
+    {
+        delete[] arr;
+    }
+};
+
+/**
+ * LRU Cache Implementation
+ *
+ * Allocation-free: the list nodes live in an array of capacity slots linked by 32 bit
+ * indices, with slot capacity as the sentinel, and a flat hash maps VPN to slot.
+ */
+class LRUCache
+{
+private:
+    DLLSlot *slots; // slots[capacity] is the sentinel (front is its next, rear its prev)
+    uint32_t size;
+    uint32_t capacity;
+    FlatHashMap mp;     // element -> slot index
+    uint32_t foundSlot; // slot of element found by last successful lookup
+
+    /**
+     * Insert slot at front of DLL
+     */
+    void insertAtFront(uint32_t slot)
+    {
+        uint32_t head = capacity;
+        slots[slot].next = slots[head].next;
+        slots[slot].prev = head;
+        slots[slots[head].next].prev = slot;
+        slots[head].next = slot;
+        size++;
+    }
+
+    /**
+     * Delete slot from DLL
+     */
+    void deleteNode(uint32_t slot)
+    {
+        slots[slots[slot].prev].next = slots[slot].next;
+        slots[slots[slot].next].prev = slots[slot].prev;
+        size--;
+    }
+
+public:
+    /**
+     * Constructor
+     */
+    LRUCache(uint32_t capacity) : size(0), capacity(capacity), mp(capacity), foundSlot(0)
+    {
+        slots = new DLLSlot[capacity + 1];
+        slots[capacity].next = capacity;
+        slots[capacity].prev = capacity;
+    }
+
+    /**
+     * Check if element is in Cache
+     */
+    bool lookup(uint32_t data)
+    {
+        foundSlot = mp.find(data);
+        return foundSlot != FlatHashMap::NOT_FOUND;
+    }
+
+    /**
+     * Move element found by lookup to front
+     */
+    void touch(uint32_t data, uint32_t i)
+    {
+        deleteNode(foundSlot);
+        insertAtFront(foundSlot);
+    }
+
+    /**
+     * Evict element from Cache according to LRU policy, returns the freed slot
+     */
+    uint32_t evict()
+    {
+        uint32_t slot = slots[capacity].prev; // rear
+        deleteNode(slot);
+        mp.erase(slots[slot].data);
+        return slot;
+    }
+
+    /**
+     * Insert element in Cache
+     */
+    void insert(uint32_t data, uint32_t i)
+    {
+        // slots 0..size-1 are in use until the cache first fills up
+        uint32_t slot = size;
+        if (size == capacity)
+        {
+            slot = evict();
+        }
+        slots[slot].data = data;
+        insertAtFront(slot);
+        mp.insert(data, slot);
+    }
+
+    /**
+     * Destructor
+     */
+    ~LRUCache()
+    {
+        delete[] slots;
+    }
+};
+
+/**
+ * Optimal Cache Implementation
+ *
+ * Elements are dense ids 0..universe-1 (see remapDense), so heap positions are kept
+ * in a plain array instead of a hash map. The heap is keyed by next occurrence, so the
+ * element used farthest in the future is at the root. It is 4-ary: the 4 children of a
+ * node are adjacent 8 byte (key, value) pairs, so a sift-down level reads one cache
+ * line and the heap is half as deep as a binary one. Sifts move a hole instead of
+ * swapping, writing each moved element's position once.
+ */
+class OptimalCache
+{
+private:
+    static const uint32_t NOT_IN_CACHE = 0xFFFFFFFF;
+    static const uint32_t ARITY = 4;
+    HeapNode *arr; // array representation of heap
+    uint32_t capacity;
+    uint32_t size;
+    uint32_t *mp;                    // index of each dense id in heap array (NOT_IN_CACHE if absent)
+    uint32_t universe;               // number of dense ids
+    const uint32_t *nextOccurrence; // next occurrence of the element at each trace index
+
+    /**
+     * Upheap operation
+     */
+    void upHeap(uint32_t idx)
+    {
+        HeapNode node = arr[idx];
+        while (idx > 0)
+        {
+            uint32_t parent = (idx - 1) / ARITY;
+            if (arr[parent].key >= node.key)
+                break;
+            arr[idx] = arr[parent];
+            mp[arr[idx].value] = idx;
+            idx = parent;
+        }
+        arr[idx] = node;
+        mp[node.value] = idx;
+    }
+
+    /**
+     * Downheap operation
+     */
+    void downHeap(uint32_t idx)
+    {
+        HeapNode node = arr[idx];
+        while (ARITY * idx + 1 < size)
+        {
+            uint32_t first = ARITY * idx + 1;
+            uint32_t last = min(first + ARITY, size);
+            uint32_t largest = first;
+            for (uint32_t child = first + 1; child < last; child++)
+            {
+                if (arr[child].key > arr[largest].key)
+                {
+                    largest = child;
+                }
+            }
+            if (arr[largest].key <= node.key)
+                break;
+            arr[idx] = arr[largest];
+            mp[arr[idx].value] = idx;
+            idx = largest;
+        }
+        arr[idx] = node;
+        mp[node.value] = idx;
+    }
+
+public:
+    /**
+     * Constructor
+     */
+    OptimalCache(uint32_t capacity, uint32_t universe, const uint32_t *nextOccurrence)
+        : capacity(capacity), size(0), universe(universe), nextOccurrence(nextOccurrence)
+    {
+        arr = new HeapNode[capacity];
+        mp = new uint32_t[universe];
+        memset(mp, 0xFF, universe * sizeof(uint32_t));
+    }
+
+    /**
+     * Check if element is in Cache
+     */
+    bool lookup(uint32_t data)
+    {
+        return mp[data] != NOT_IN_CACHE;
+    }
+
+    /**
+     * Update next occurrence of element on a hit at trace index i
+     *
+     * Its key was i, the occurrence being processed, and becomes a later occurrence, so
+     * the key only grows and a single sift towards the root restores the max-heap.
+     */
+    void touch(uint32_t data, uint32_t i)
+    {
+        uint32_t idx = mp[data];
+        arr[idx].key = nextOccurrence[i];
+        upHeap(idx);
+    }
+
+    /**
+     * Evict element from Cache according to Optimal policy
+     */
+    void evict()
+    {
+        if (size == 0)
+            return;
+        mp[arr[0].value] = NOT_IN_CACHE;
+        size--;
+        if (size > 0)
+        {
+            arr[0] = arr[size];
+            downHeap(0);
+        }
+    }
+
+    /**
+     * Insert element in Cache on a miss at trace index i
+     */
+    void insert(uint32_t data, uint32_t i)
+    {
+        if (size == capacity)
+        {
+            evict();
+        }
+        arr[size] = HeapNode(nextOccurrence[i], data);
+        upHeap(size);
+        size++;
+    }
+
+    /**
+     * Destructor
+     */
+    ~OptimalCache()
+    {
+        delete[] arr;
+        delete[] mp;
+    }
+};
+
+/**
+ * Optimal Cache with bounded lookahead
+ *
+ * Elements are arbitrary keys held in capacity slots, and the heap orders slots by the
+ * next use of their element. A next use beyond the lookahead window is UNKNOWN, which
+ * ranks farthest; reveal() sets it once the use enters the window. Evicting an UNKNOWN
+ * element while another resident one is also UNKNOWN is a guess, which is where the
+ * result can differ from exact Optimal.
+ */
+class WindowedOptimalCache
+{
+private:
+    HeapNode *arr;    // (next use, slot), max-heap on next use
+    uint32_t *data;   // element in each slot
+    uint32_t *pos;    // heap index of each slot
+    uint32_t capacity;
+    uint32_t size;
+    FlatHashMap mp;     // element -> slot
+    uint32_t foundSlot; // slot of element found by last successful lookup
+    uint32_t unknown;   // resident elements whose next use is UNKNOWN
+
+    /**
+     * Upheap operation
+     */
+    void upHeap(uint32_t idx)
+    {
+        while (idx > 0)
+        {
+            uint32_t parent = (idx - 1) / 2;
+            if (arr[parent].key >= arr[idx].key)
+                break;
+            swap(arr[parent], arr[idx]);
+            pos[arr[parent].value] = parent;
+            pos[arr[idx].value] = idx;
+            idx = parent;
+        }
+    }
+
+    /**
+     * Downheap operation
+     */
+    void downHeap(uint32_t idx)
+    {
+        while (2 * idx + 1 < size)
+        {
+            uint32_t largest = 2 * idx + 1;
+            if (largest + 1 < size && arr[largest + 1].key > arr[largest].key)
+            {
+                largest++;
+            }
+            if (arr[largest].key <= arr[idx].key)
+                break;
+            swap(arr[largest], arr[idx]);
+            pos[arr[largest].value] = largest;
+            pos[arr[idx].value] = idx;
+            idx = largest;
+        }
+    }
+
+    /**
+     * Set next use of the element in slot
+     */
+    void setNextUse(uint32_t slot, uint32_t next)
+    {
+        uint32_t idx = pos[slot];
+        unknown += (next == UNKNOWN) - (arr[idx].key == UNKNOWN);
+        arr[idx].key = next;
+        upHeap(idx);
+        downHeap(pos[slot]);
+    }
+
+public:
+    static const uint32_t UNKNOWN = 0xFFFFFFFF;
+
+    /**
+     * Constructor
+     */
+    WindowedOptimalCache(uint32_t capacity) : capacity(capacity), size(0), mp(capacity), foundSlot(0), unknown(0)
+    {
+        arr = new HeapNode[capacity];
+        data = new uint32_t[capacity];
+        pos = new uint32_t[capacity];
+    }
+
+    /**
+     * Check if element is in Cache
+     */
+    bool lookup(uint32_t element)
+    {
+        foundSlot = mp.find(element);
+        return foundSlot != FlatHashMap::NOT_FOUND;
+    }
+
+    /**
+     * Set next use of element found by lookup on a hit
+     */
+    void touch(uint32_t element, uint32_t next)
+    {
+        setNextUse(foundSlot, next);
+    }
+
+    /**
+     * Next use of element has entered the window
+     */
+    void reveal(uint32_t element, uint32_t next)
+    {
+        uint32_t slot = mp.find(element);
+        if (slot != FlatHashMap::NOT_FOUND && arr[pos[slot]].key == UNKNOWN)
+        {
+            setNextUse(slot, next);
+        }
+    }
+
+    /**
+     * True if the next insert has to guess between elements with UNKNOWN next use
+     */
+    bool guessingVictim() const
+    {
+        return size == capacity && arr[0].key == UNKNOWN && unknown >= 2;
+    }
+
+    /**
+     * Evict element used farthest in the future, returns its slot
+     */
+    uint32_t evict()
+    {
+        uint32_t slot = arr[0].value;
+        unknown -= arr[0].key == UNKNOWN;
+        mp.erase(data[slot]);
+        size--;
+        if (size > 0)
+        {
+            arr[0] = arr[size];
+            pos[arr[0].value] = 0;
+            downHeap(0);
+        }
+        return slot;
+    }
+
+    /**
+     * Insert element on a miss, with its next use
+     */
+    void insert(uint32_t element, uint32_t next)
+    {
+        // slots 0..size-1 are in use until the cache first fills up
+        uint32_t slot = size;
+        if (size == capacity)
+        {
+            slot = evict();
+        }
+        data[slot] = element;
+        mp.insert(element, slot);
+        arr[size] = HeapNode(next, slot);
+        pos[slot] = size;
+        unknown += next == UNKNOWN;
+        upHeap(size);
+        size++;
+    }
+
+    /**
+     * Destructor
+     */
+    ~WindowedOptimalCache()
+    {
+        delete[] arr;
+        delete[] data;
+        delete[] pos;
+    }
+};
+
+/**
+ * ARC (Adaptive Replacement Cache) Implementation
+ *
+ * Resident pages are split into T1 (seen once recently) and T2 (seen at least twice),
+ * both in LRU order; ghost lists B1 and B2 remember the pages recently evicted from
+ * each. A ghost hit in B1 grows the target size p of T1, a ghost hit in B2 shrinks it,
+ * so the cache adapts between recency and frequency. All four lists share one pool of
+ * 2 * capacity slots.
+ */
+class ARCCache
+{
+private:
+    enum
+    {
+        T1,
+        T2,
+        B1,
+        B2
+    };
+    SlotLists lists;
+    FlatHashMap mp; // page -> slot, for resident and ghost pages
+    uint32_t capacity;
+    uint32_t p;         // target size of T1
+    uint32_t foundSlot; // slot found by last lookup (resident, ghost or NOT_FOUND)
+    bool ghostInB2;     // page being inserted is a ghost hit in B2
+
+    /**
+     * Forget the LRU page of list
+     */
+    void discard(uint32_t list)
+    {
+        uint32_t slot = lists.front(list);
+        mp.erase(lists.data(slot));
+        lists.remove(slot);
+    }
+
+    /**
+     * Number of pages in all four lists
+     */
+    uint32_t total() const
+    {
+        return lists.size(T1) + lists.size(T2) + lists.size(B1) + lists.size(B2);
+    }
+
+public:
+    /**
+     * Constructor
+     */
+    ARCCache(uint32_t capacity)
+        : lists(2 * capacity, 4), mp(2 * capacity), capacity(capacity), p(0), foundSlot(0), ghostInB2(false) {}
+
+    /**
+     * Check if element is in Cache (ghosts do not count)
+     */
+    bool lookup(uint32_t data)
+    {
+        foundSlot = mp.find(data);
+        return foundSlot != FlatHashMap::NOT_FOUND && lists.listOf(foundSlot) <= T2;
+    }
+
+    /**
+     * Move element found by lookup to MRU end of T2
+     */
+    void touch(uint32_t data, uint32_t i)
+    {
+        lists.moveToBack(T2, foundSlot);
+    }
+
+    /**
+     * Demote the LRU page of T1 or T2 to its ghost list (REPLACE in the ARC paper)
+     */
+    void evict()
+    {
+        uint32_t t1 = lists.size(T1);
+        if (t1 >= 1 && (t1 > p || (ghostInB2 && t1 == p)))
+        {
+            lists.moveToBack(B1, lists.front(T1));
+        }
+        else
+        {
+            lists.moveToBack(B2, lists.front(T2));
+        }
+    }
+
+    /**
+     * Insert element on a miss, right after its lookup
+     */
+    void insert(uint32_t data, uint32_t i)
+    {
+        uint32_t slot = foundSlot;
+        ghostInB2 = slot != FlatHashMap::NOT_FOUND && lists.listOf(slot) == B2;
+        if (slot != FlatHashMap::NOT_FOUND)
+        {
+            // ghost hit: adapt p, then bring the page back into T2
+            uint32_t b1 = lists.size(B1), b2 = lists.size(B2);
+            if (ghostInB2)
+            {
+                uint32_t delta = max(b1 / b2, 1u);
+                p = p > delta ? p - delta : 0;
+            }
+            else
+            {
+                p = min(capacity, p + max(b2 / b1, 1u));
+            }
+            evict();
+            lists.moveToBack(T2, slot);
+            return;
+        }
+        if (lists.size(T1) + lists.size(B1) == capacity)
+        {
+            if (lists.size(T1) < capacity)
+            {
+                discard(B1);
+                evict();
+            }
+            else
+            {
+                discard(T1);
+            }
+        }
+        else if (total() >= capacity)
+        {
+            if (total() == 2 * capacity)
+            {
+                discard(B2);
+            }
+            evict();
+        }
+        mp.insert(data, lists.add(T1, data));
+    }
+};
+
+/**
+ * CAR (Clock with Adaptive Replacement) Implementation
+ *
+ * ARC with the LRU lists T1 and T2 replaced by clocks: a hit only sets the reference
+ * bit of the page. The front of a clock list is its hand; a referenced page under the
+ * hand gets its bit cleared and moves to the back of T2. Ghost lists B1 and B2 and the
+ * adaptation of p are as in ARC.
+ */
+class CARCache
+{
+private:
+    enum
+    {
+        T1,
+        T2,
+        B1,
+        B2
+    };
+    SlotLists lists;
+    FlatHashMap mp;      // page -> slot, for resident and ghost pages
+    uint8_t *referenced; // reference bit of each slot
+    uint32_t capacity;
+    uint32_t p;         // target size of T1
+    uint32_t foundSlot; // slot found by last lookup (resident, ghost or NOT_FOUND)
+
+    /**
+     * Forget the LRU page of ghost list
+     */
+    void discard(uint32_t list)
+    {
+        uint32_t slot = lists.front(list);
+        mp.erase(lists.data(slot));
+        lists.remove(slot);
+    }
+
+public:
+    /**
+     * Constructor
+     */
+    CARCache(uint32_t capacity) : lists(2 * capacity, 4), mp(2 * capacity), capacity(capacity), p(0), foundSlot(0)
+    {
+        referenced = new uint8_t[2 * capacity];
+    }
+
+    /**
+     * Check if element is in Cache (ghosts do not count)
+     */
+    bool lookup(uint32_t data)
+    {
+        foundSlot = mp.find(data);
+        return foundSlot != FlatHashMap::NOT_FOUND && lists.listOf(foundSlot) <= T2;
+    }
+
+    /**
+     * Set reference bit of element found by lookup
+     */
+    void touch(uint32_t data, uint32_t i)
+    {
+        referenced[foundSlot] = 1;
+    }
+
+    /**
+     * Advance the clock hands until an unreferenced page is demoted to a ghost list
+     */
+    void evict()
+    {
+        while (true)
+        {
+            uint32_t list = lists.size(T1) >= max(1u, p) ? T1 : T2;
+            uint32_t slot = lists.front(list);
+            if (!referenced[slot])
+            {
+                lists.moveToBack(list == T1 ? B1 : B2, slot);
+                return;
+            }
+            referenced[slot] = 0;
+            lists.moveToBack(T2, slot);
+        }
+    }
+
+    /**
+     * Insert element on a miss, right after its lookup
+     */
+    void insert(uint32_t data, uint32_t i)
+    {
+        uint32_t slot = foundSlot;
+        bool ghost = slot != FlatHashMap::NOT_FOUND;
+        if (lists.size(T1) + lists.size(T2) == capacity)
+        {
+            evict();
+            if (!ghost)
+            {
+                if (lists.size(T1) + lists.size(B1) == capacity && lists.size(B1) > 0)
+                {
+                    discard(B1);
+                }
+                else if (lists.size(T1) + lists.size(T2) + lists.size(B1) + lists.size(B2) == 2 * capacity)
+                {
+                    discard(B2);
+                }
+            }
+        }
+        if (!ghost)
+        {
+            slot = lists.add(T1, data);
+            mp.insert(data, slot);
+        }
+        else
+        {
+            uint32_t b1 = lists.size(B1), b2 = lists.size(B2);
+            if (lists.listOf(slot) == B1)
+            {
+                p = min(capacity, p + max(b2 / b1, 1u));
+            }
+            else
+            {
+                uint32_t delta = max(b1 / b2, 1u);
+                p = p > delta ? p - delta : 0;
+            }
+            lists.moveToBack(T2, slot);
+        }
+        referenced[slot] = 0;
+    }
+
+    /**
+     * Destructor
+     */
+    ~CARCache()
+    {
+        delete[] referenced;
+    }
+};
+
+/**
+ * 2Q Cache Implementation (full version of Johnson and Shasha)
+ *
+ * A page seen for the first time enters A1in, a FIFO of about capacity / 4 pages. Pages
+ * evicted from A1in are remembered in the ghost FIFO A1out (capacity / 2 pages), and only
+ * a page referenced again while in A1out is admitted to Am, the LRU main region. A scan
+ * therefore passes through A1in without displacing the hot pages in Am.
+ */
+class TwoQCache
+{
+private:
+    enum
+    {
+        A1IN,
+        AM,
+        A1OUT
+    };
+    SlotLists lists;
+    FlatHashMap mp; // page -> slot, for resident and ghost pages
+    uint32_t capacity;
+    uint32_t maxIn;     // A1in size above which A1in is evicted from first
+    uint32_t maxOut;    // A1out size
+    uint32_t foundSlot; // slot found by last lookup (resident, ghost or NOT_FOUND)
+
+public:
+    /**
+     * Constructor
+     */
+    TwoQCache(uint32_t capacity)
+        : lists(capacity + max(1u, capacity / 2) + 1, 3), mp(capacity + max(1u, capacity / 2) + 1), capacity(capacity),
+          maxIn(max(1u, capacity / 4)), maxOut(max(1u, capacity / 2)), foundSlot(0) {}
+
+    /**
+     * Check if element is in Cache (ghosts do not count)
+     */
+    bool lookup(uint32_t data)
+    {
+        foundSlot = mp.find(data);
+        return foundSlot != FlatHashMap::NOT_FOUND && lists.listOf(foundSlot) != A1OUT;
+    }
+
+    /**
+     * On a hit, move a page of Am to its MRU end (hits in A1in do not reorder)
+     */
+    void touch(uint32_t data, uint32_t i)
+    {
+        if (lists.listOf(foundSlot) == AM)
+        {
+            lists.moveToBack(AM, foundSlot);
+        }
+    }
+
+    /**
+     * Free one resident slot: the oldest page of A1in goes to A1out if A1in is over its
+     * share, otherwise the LRU page of Am is dropped
+     */
+    void evict()
+    {
+        if (lists.size(A1IN) > maxIn || lists.size(AM) == 0)
+        {
+            lists.moveToBack(A1OUT, lists.front(A1IN));
+            if (lists.size(A1OUT) > maxOut)
+            {
+                uint32_t slot = lists.front(A1OUT);
+                mp.erase(lists.data(slot));
+                lists.remove(slot);
+            }
+        }
+        else
+        {
+            uint32_t slot = lists.front(AM);
+            mp.erase(lists.data(slot));
+            lists.remove(slot);
+        }
+    }
+
+    /**
+     * Insert element on a miss, right after its lookup
+     */
+    void insert(uint32_t data, uint32_t i)
+    {
+        bool ghost = foundSlot != FlatHashMap::NOT_FOUND;
+        if (ghost)
+        {
+            // forget the ghost first so evict() cannot drop it
+            mp.erase(data);
+            lists.remove(foundSlot);
+        }
+        if (lists.size(A1IN) + lists.size(AM) == capacity)
+        {
+            evict();
+        }
+        mp.insert(data, lists.add(ghost ? AM : A1IN, data));
+    }
+};
+
+/**
+ * LIRS Cache Implementation
+ *
+ * Pages with a small inter-reference recency are LIR and always resident; the rest are
+ * HIR, of which only about 1% of the capacity is resident, in the FIFO queue Q. The
+ * stack S orders LIR pages and recently seen HIR pages (resident or not) by recency,
+ * and its bottom is always a LIR page (stack pruning). A HIR page referenced again
+ * while still on S has a smaller recency than the bottom LIR page and swaps status
+ * with it. Non-resident entries of S are limited to capacity; beyond that the one
+ * made non-resident first is dropped.
+ */
+class LIRSCache
+{
+private:
+    enum State : uint8_t
+    {
+        LIR,
+        HIR,         // resident HIR, in Q
+        NONRESIDENT, // non-resident HIR, on S only
+    };
+    uint32_t capacity;
+    uint32_t maxLIR;
+    uint32_t numLIR;
+    uint32_t resident;
+    uint32_t *pages; // page of each slot
+    State *state;    // state of each slot
+    IndexList stack; // S, bottom at front
+    IndexList queue; // Q, next victim at front
+    IndexList ghosts; // non-resident entries of S, oldest at front
+    IndexList freeSlots;
+    FlatHashMap mp;     // page -> slot, for every page on S or Q
+    uint32_t foundSlot; // slot found by last lookup
+
+    /**
+     * Release slot of a page no longer on S or Q
+     */
+    void forget(uint32_t slot)
+    {
+        mp.erase(pages[slot]);
+        freeSlots.pushBack(slot);
+    }
+
+    /**
+     * Remove HIR entries from the bottom of S until a LIR page is at the bottom
+     */
+    void prune()
+    {
+        while (stack.size() > 0 && state[stack.front()] != LIR)
+        {
+            uint32_t slot = stack.front();
+            stack.remove(slot);
+            if (state[slot] == NONRESIDENT)
+            {
+                ghosts.remove(slot);
+                forget(slot);
+            }
+        }
+    }
+
+    /**
+     * Make slot (on top of S) LIR, turning LIR pages at the bottom of S into resident HIR
+     */
+    void promote(uint32_t slot)
+    {
+        state[slot] = LIR;
+        numLIR++;
+        prune(); // without LIR pages (capacity 1) S may have HIR entries at the bottom
+        while (numLIR > maxLIR)
+        {
+            uint32_t bottom = stack.front();
+            stack.remove(bottom);
+            state[bottom] = HIR;
+            queue.pushBack(bottom);
+            numLIR--;
+            prune();
+        }
+    }
+
+public:
+    /**
+     * Constructor
+     */
+    LIRSCache(uint32_t capacity)
+        : capacity(capacity), maxLIR(capacity - max(1u, capacity / 100)), numLIR(0), resident(0),
+          stack(2 * capacity + 1), queue(2 * capacity + 1), ghosts(2 * capacity + 1), freeSlots(2 * capacity + 1),
+          mp(2 * capacity + 1), foundSlot(0)
+    {
+        pages = new uint32_t[2 * capacity + 1];
+        state = new State[2 * capacity + 1];
+        for (uint32_t slot = 0; slot < 2 * capacity + 1; slot++)
+        {
+            freeSlots.pushBack(slot);
+        }
+    }
+
+    /**
+     * Check if element is in Cache (non-resident entries do not count)
+     */
+    bool lookup(uint32_t data)
+    {
+        foundSlot = mp.find(data);
+        return foundSlot != FlatHashMap::NOT_FOUND && state[foundSlot] != NONRESIDENT;
+    }
+
+    /**
+     * Update S and Q on a hit of the element found by lookup
+     */
+    void touch(uint32_t data, uint32_t i)
+    {
+        uint32_t slot = foundSlot;
+        if (state[slot] == LIR)
+        {
+            bool bottom = stack.front() == slot;
+            stack.moveToBack(slot);
+            if (bottom)
+            {
+                prune();
+            }
+        }
+        else if (stack.contains(slot))
+        {
+            stack.moveToBack(slot);
+            queue.remove(slot);
+            promote(slot);
+        }
+        else
+        {
+            stack.pushBack(slot);
+            queue.moveToBack(slot);
+        }
+    }
+
+    /**
+     * Evict the resident HIR page at the front of Q, keeping it on S as non-resident
+     */
+    void evict()
+    {
+        uint32_t slot = queue.front();
+        queue.remove(slot);
+        resident--;
+        if (stack.contains(slot))
+        {
+            state[slot] = NONRESIDENT;
+            ghosts.pushBack(slot);
+        }
+        else
+        {
+            forget(slot);
+        }
+    }
+
+    /**
+     * Insert element on a miss, right after its lookup
+     */
+    void insert(uint32_t data, uint32_t i)
+    {
+        if (resident == capacity)
+        {
+            evict();
+        }
+        resident++;
+        uint32_t slot = foundSlot;
+        if (slot != FlatHashMap::NOT_FOUND)
+        {
+            // non-resident HIR page still on S: its recency beats the bottom LIR page
+            ghosts.remove(slot);
+            stack.moveToBack(slot);
+            promote(slot);
+            return;
+        }
+        slot = freeSlots.front();
+        freeSlots.remove(slot);
+        pages[slot] = data;
+        mp.insert(data, slot);
+        stack.pushBack(slot);
+        if (numLIR < maxLIR)
+        {
+            state[slot] = LIR; // cache still warming up
+            numLIR++;
+        }
+        else
+        {
+            state[slot] = HIR;
+            queue.pushBack(slot);
+        }
+        while (ghosts.size() > capacity)
+        {
+            uint32_t ghost = ghosts.front();
+            ghosts.remove(ghost);
+            stack.remove(ghost);
+            forget(ghost);
+        }
+    }
+
+    /**
+     * Destructor
+     */
+    ~LIRSCache()
+    {
+        delete[] pages;
+        delete[] state;
+    }
+};
+
+/**
+ * CLOCK (second chance) Cache Implementation
+ *
+ * Pages sit in a flat array of capacity slots with one reference bit each. A hit only
+ * sets the bit. To evict, the hand sweeps the slots circularly, clearing set bits, and
+ * replaces the first page whose bit is already clear. A page is loaded with its bit
+ * set, since the access that loads it is a reference.
+ */
+class ClockCache
+{
+private:
+    uint32_t *pages;     // page in each slot
+    uint8_t *referenced; // reference bit of each slot
+    uint32_t capacity;
+    uint32_t size;
+    uint32_t hand;
+    FlatHashMap mp;     // page -> slot
+    uint32_t foundSlot; // slot of element found by last successful lookup
+
+public:
+    /**
+     * Constructor
+     */
+    ClockCache(uint32_t capacity) : capacity(capacity), size(0), hand(0), mp(capacity), foundSlot(0)
+    {
+        pages = new uint32_t[capacity];
+        referenced = new uint8_t[capacity];
+    }
+
+    /**
+     * Check if element is in Cache
+     */
+    bool lookup(uint32_t data)
+    {
+        foundSlot = mp.find(data);
+        return foundSlot != FlatHashMap::NOT_FOUND;
+    }
+
+    /**
+     * Set reference bit of element found by lookup
+     */
+    void touch(uint32_t data, uint32_t i)
+    {
+        referenced[foundSlot] = 1;
+    }
+
+    /**
+     * Advance the hand to the first page with a clear bit and evict it, returns its slot
+     */
+    uint32_t evict()
+    {
+        while (referenced[hand])
+        {
+            referenced[hand] = 0;
+            hand = hand + 1 == capacity ? 0 : hand + 1;
+        }
+        uint32_t slot = hand;
+        mp.erase(pages[slot]);
+        hand = hand + 1 == capacity ? 0 : hand + 1;
+        return slot;
+    }
+
+    /**
+     * Insert element in Cache
+     */
+    void insert(uint32_t data, uint32_t i)
+    {
+        uint32_t slot = size < capacity ? size++ : evict();
+        pages[slot] = data;
+        referenced[slot] = 1;
+        mp.insert(data, slot);
+    }
+
+    /**
+     * Destructor
+     */
+    ~ClockCache()
+    {
+        delete[] pages;
+        delete[] referenced;
+    }
+};
+
+/**
+ * CLOCK-Pro Cache Implementation (Jiang, Chen and Zhang)
+ *
+ * One circular list of slots holds hot pages, resident cold pages and non-resident
+ * cold pages still in their test period; a hit only sets the reference bit. New pages
+ * enter as cold pages in test at the list head (just behind HAND_hot). Three hands
+ * sweep the circle:
+ *   HAND_cold  evicts the first unreferenced resident cold page; a referenced one is
+ *              promoted to hot if in test, or else given a new test period at the head
+ *   HAND_hot   demotes the first unreferenced hot page to cold while there are more hot
+ *              pages than capacity - coldTarget, ending the test periods it passes
+ *   HAND_test  ends test periods until a non-resident page can be dropped, keeping
+ *              non-resident pages at most capacity
+ * coldTarget grows when a cold page is re-referenced in its test period and shrinks
+ * when a test period ends without one. Slots are preallocated; nothing is allocated
+ * after construction.
+ */
+class ClockProCache
+{
+private:
+    static const uint32_t NONE = 0xFFFFFFFF;
+    uint32_t capacity;
+    uint32_t *pages;
+    uint32_t *next; // circular list, clockwise
+    uint32_t *prev;
+    uint8_t *hot;
+    uint8_t *resident;
+    uint8_t *inTest;
+    uint8_t *referenced;
+    IndexList freeSlots;
+    FlatHashMap mp; // page -> slot, for every page on the circle
+    uint32_t handHot;
+    uint32_t handCold;
+    uint32_t handTest;
+    uint32_t numHot;
+    uint32_t numResident;
+    uint32_t numNonResident;
+    uint32_t coldTarget;
+    uint32_t foundSlot; // slot found by last lookup
+
+    /**
+     * Insert slot at the list head, just behind HAND_hot
+     */
+    void insertAtHead(uint32_t slot)
+    {
+        if (handHot == NONE)
+        {
+            next[slot] = prev[slot] = slot;
+            handHot = handCold = handTest = slot;
+            return;
+        }
+        next[slot] = handHot;
+        prev[slot] = prev[handHot];
+        next[prev[handHot]] = slot;
+        prev[handHot] = slot;
+    }
+
+    /**
+     * Unlink slot from the circle, moving hands that point at it forward
+     */
+    void unlink(uint32_t slot)
+    {
+        uint32_t after = next[slot] == slot ? NONE : next[slot];
+        handHot = handHot == slot ? after : handHot;
+        handCold = handCold == slot ? after : handCold;
+        handTest = handTest == slot ? after : handTest;
+        next[prev[slot]] = next[slot];
+        prev[next[slot]] = prev[slot];
+    }
+
+    /**
+     * Drop a page from the circle and free its slot
+     */
+    void forget(uint32_t slot)
+    {
+        unlink(slot);
+        mp.erase(pages[slot]);
+        freeSlots.pushBack(slot);
+    }
+
+    /**
+     * End the test period of a cold page without re-reference
+     */
+    void endTest(uint32_t slot)
+    {
+        inTest[slot] = 0;
+        coldTarget = max(1u, coldTarget - 1);
+        if (!resident[slot])
+        {
+            numNonResident--;
+            forget(slot);
+        }
+    }
+
+    /**
+     * A cold page was re-referenced in its test period
+     */
+    void growCold()
+    {
+        coldTarget = min(max(1u, capacity - 1), coldTarget + 1);
+    }
+
+    /**
+     * Turn slot into a hot page, then demote hot pages beyond their share
+     */
+    void makeHot(uint32_t slot)
+    {
+        hot[slot] = 1;
+        inTest[slot] = 0;
+        numHot++;
+        while (numHot > capacity - coldTarget)
+        {
+            runHandHot();
+        }
+    }
+
+    /**
+     * Advance HAND_hot until one hot page is demoted to cold
+     */
+    void runHandHot()
+    {
+        while (true)
+        {
+            uint32_t slot = handHot;
+            handHot = next[slot];
+            if (hot[slot])
+            {
+                if (referenced[slot])
+                {
+                    referenced[slot] = 0;
+                    continue;
+                }
+                hot[slot] = 0;
+                numHot--;
+                return;
+            }
+            if (inTest[slot])
+            {
+                endTest(slot);
+            }
+        }
+    }
+
+    /**
+     * Advance HAND_test until one non-resident page is dropped
+     */
+    void runHandTest()
+    {
+        while (true)
+        {
+            uint32_t slot = handTest;
+            handTest = next[slot];
+            if (!hot[slot] && inTest[slot])
+            {
+                bool dropped = !resident[slot];
+                endTest(slot);
+                if (dropped)
+                    return;
+            }
+        }
+    }
+
+public:
+    /**
+     * Constructor
+     */
+    ClockProCache(uint32_t capacity)
+        : capacity(capacity), freeSlots(2 * capacity + 2), mp(2 * capacity + 2), handHot(NONE), handCold(NONE),
+          handTest(NONE), numHot(0), numResident(0), numNonResident(0), coldTarget(1), foundSlot(0)
+    {
+        uint32_t slots = 2 * capacity + 2;
+        pages = new uint32_t[slots];
+        next = new uint32_t[slots];
+        prev = new uint32_t[slots];
+        hot = new uint8_t[slots];
+        resident = new uint8_t[slots];
+        inTest = new uint8_t[slots];
+        referenced = new uint8_t[slots];
+        for (uint32_t slot = 0; slot < slots; slot++)
+        {
+            freeSlots.pushBack(slot);
+        }
+    }
+
+    /**
+     * Check if element is in Cache (non-resident pages do not count)
+     */
+    bool lookup(uint32_t data)
+    {
+        foundSlot = mp.find(data);
+        return foundSlot != FlatHashMap::NOT_FOUND && resident[foundSlot];
+    }
+
+    /**
+     * Set reference bit of element found by lookup
+     */
+    void touch(uint32_t data, uint32_t i)
+    {
+        referenced[foundSlot] = 1;
+    }
+
+    /**
+     * Advance HAND_cold until one resident cold page is evicted
+     */
+    void evict()
+    {
+        while (true)
+        {
+            uint32_t slot = handCold;
+            handCold = next[slot];
+            if (hot[slot] || !resident[slot])
+                continue;
+            if (!referenced[slot])
+            {
+                resident[slot] = 0;
+                numResident--;
+                if (inTest[slot])
+                {
+                    numNonResident++; // stays on the circle until its test period ends
+                }
+                else
+                {
+                    forget(slot);
+                }
+                return;
+            }
+            referenced[slot] = 0;
+            if (inTest[slot])
+            {
+                growCold();
+                makeHot(slot);
+            }
+            else
+            {
+                inTest[slot] = 1;
+                unlink(slot);
+                insertAtHead(slot);
+            }
+        }
+    }
+
+    /**
+     * Insert element on a miss, right after its lookup
+     */
+    void insert(uint32_t data, uint32_t i)
+    {
+        if (numResident == capacity)
+        {
+            evict();
+        }
+        numResident++;
+        // lookup's slot may have been dropped by evict() ending its test period
+        uint32_t slot = mp.find(data);
+        if (slot != FlatHashMap::NOT_FOUND)
+        {
+            // non-resident cold page re-referenced in its test period
+            numNonResident--;
+            resident[slot] = 1;
+            referenced[slot] = 0;
+            growCold();
+            unlink(slot);
+            insertAtHead(slot);
+            makeHot(slot);
+        }
+        else
+        {
+            slot = freeSlots.front();
+            freeSlots.remove(slot);
+            pages[slot] = data;
+            hot[slot] = 0;
+            resident[slot] = 1;
+            inTest[slot] = 1;
+            referenced[slot] = 0;
+            mp.insert(data, slot);
+            insertAtHead(slot);
+        }
+        while (numNonResident > capacity)
+        {
+            runHandTest();
+        }
+    }
+
+    /**
+     * Destructor
+     */
+    ~ClockProCache()
+    {
+        delete[] pages;
+        delete[] next;
+        delete[] prev;
+        delete[] hot;
+        delete[] resident;
+        delete[] inTest;
+        delete[] referenced;
+    }
+};
+
+/**
+ * Count-Min sketch of 4 bit counters with periodic aging
+ *
+ * Counters are packed 16 to a 64 bit word, one word per expected element (8 bytes per
+ * entry). Each key increments 4 counters picked by independent hashes and its estimate
+ * is their minimum. After 10 increments per word every counter is halved, so old
+ * popularity decays and the sketch follows phase changes.
+ */
+class FrequencySketch
+{
+private:
+    uint64_t *table;
+    uint32_t mask;       // counters - 1
+    uint32_t additions;  // increments since last aging
+    uint32_t sampleSize; // increments between agings
+
+    /**
+     * Index of the counter of key in row (0..3)
+     */
+    uint32_t counter(uint32_t key, uint32_t row) const
+    {
+        static const uint64_t SEEDS[4] = {0x9E3779B97F4A7C15ull, 0xC2B2AE3D27D4EB4Full, 0x165667B19E3779F9ull,
+                                          0xD6E8FEB86659FD93ull};
+        return (uint32_t)(((key + 1) * SEEDS[row]) >> 32) & mask;
+    }
+
+    /**
+     * Value of counter c
+     */
+    uint32_t get(uint32_t c) const
+    {
+        return (table[c >> 4] >> ((c & 15) << 2)) & 15;
+    }
+
+public:
+    /**
+     * Constructor
+     */
+    FrequencySketch(uint32_t capacity) : additions(0)
+    {
+        uint32_t words = 1;
+        while (words < capacity)
+        {
+            words <<= 1;
+        }
+        table = new uint64_t[words];
+        memset(table, 0, words * sizeof(uint64_t));
+        mask = words * 16 - 1;
+        sampleSize = 10 * words;
+    }
+
+    /**
+     * Count one reference to key
+     */
+    void increment(uint32_t key)
+    {
+        for (uint32_t row = 0; row < 4; row++)
+        {
+            uint32_t c = counter(key, row);
+            if (get(c) < 15)
+            {
+                table[c >> 4] += 1ull << ((c & 15) << 2);
+            }
+        }
+        if (++additions == sampleSize)
+        {
+            // halve every counter
+            for (uint32_t w = 0; w <= mask >> 4; w++)
+            {
+                table[w] = (table[w] >> 1) & 0x7777777777777777ull;
+            }
+            additions /= 2;
+        }
+    }
+
+    /**
+     * Estimated number of recent references to key
+     */
+    uint32_t frequency(uint32_t key) const
+    {
+        uint32_t f = 15;
+        for (uint32_t row = 0; row < 4; row++)
+        {
+            f = min(f, get(counter(key, row)));
+        }
+        return f;
+    }
+
+    /**
+     * Destructor
+     */
+    ~FrequencySketch()
+    {
+        delete[] table;
+    }
+};
+
+/**
+ * W-TinyLFU Cache Implementation
+ *
+ * New pages enter a small LRU window (1% of capacity). The page the window pushes out
+ * is admitted to the main region only if the frequency sketch rates it above the main
+ * region's LRU victim, otherwise it is dropped, so one-off references cannot flush
+ * popular pages. The main region is SLRU (new pages on probation, pages hit there move
+ * to a protected segment of 80%), or plain LRU with --tinylfu-lru.
+ */
+class WTinyLFUCache
+{
+private:
+    enum
+    {
+        WINDOW,
+        PROBATION,
+        PROTECTED
+    };
+    SlotLists lists;
+    FlatHashMap mp; // page -> slot
+    FrequencySketch sketch;
+    uint32_t windowSize;
+    uint32_t mainSize;
+    uint32_t protectedSize;
+    uint32_t foundSlot; // slot of element found by last successful lookup
+
+    /**
+     * Drop the page in slot from the cache
+     */
+    void drop(uint32_t slot)
+    {
+        mp.erase(lists.data(slot));
+        lists.remove(slot);
+    }
+
+public:
+    /**
+     * Constructor
+     */
+    WTinyLFUCache(uint32_t capacity, bool segmented)
+        : lists(capacity + 1, 3), mp(capacity + 1), sketch(capacity), windowSize(max(1u, capacity / 100)),
+          foundSlot(0)
+    {
+        mainSize = capacity - windowSize;
+        protectedSize = segmented ? mainSize * 4 / 5 : 0;
+    }
+
+    /**
+     * Check if element is in Cache
+     */
+    bool lookup(uint32_t data)
+    {
+        foundSlot = mp.find(data);
+        return foundSlot != FlatHashMap::NOT_FOUND;
+    }
+
+    /**
+     * Count the reference and move element found by lookup to MRU end of its region,
+     * promoting a page on probation to the protected segment
+     */
+    void touch(uint32_t data, uint32_t i)
+    {
+        sketch.increment(data);
+        uint32_t list = lists.listOf(foundSlot);
+        if (list != PROBATION || protectedSize == 0)
+        {
+            lists.moveToBack(list, foundSlot);
+            return;
+        }
+        lists.moveToBack(PROTECTED, foundSlot);
+        if (lists.size(PROTECTED) > protectedSize)
+        {
+            lists.moveToBack(PROBATION, lists.front(PROTECTED));
+        }
+    }
+
+    /**
+     * Move the window's LRU page to the main region if it wins admission, else drop it
+     */
+    void evict()
+    {
+        uint32_t candidate = lists.front(WINDOW);
+        if (lists.size(PROBATION) + lists.size(PROTECTED) < mainSize)
+        {
+            lists.moveToBack(PROBATION, candidate);
+            return;
+        }
+        if (mainSize == 0)
+        {
+            drop(candidate);
+            return;
+        }
+        uint32_t victim = lists.front(lists.size(PROBATION) > 0 ? PROBATION : PROTECTED);
+        if (sketch.frequency(lists.data(candidate)) > sketch.frequency(lists.data(victim)))
+        {
+            drop(victim);
+            lists.moveToBack(PROBATION, candidate);
+        }
+        else
+        {
+            drop(candidate);
+        }
+    }
+
+    /**
+     * Insert element in the window
+     */
+    void insert(uint32_t data, uint32_t i)
+    {
+        sketch.increment(data);
+        mp.insert(data, lists.add(WINDOW, data));
+        if (lists.size(WINDOW) > windowSize)
+        {
+            evict();
+        }
+    }
+};
+
+/**
+ * Set-associative Cache Implementation
+ *
+ * The set of an element is given by its low bits, the remaining bits are the tag. The
+ * tags of a set are contiguous (padded to a multiple of 8 ways) and probed with one
+ * SIMD compare per 4 (SSE2) or 8 (AVX2) ways; a per-set valid mask filters the result.
+ * The per-set policy is a template parameter so it is resolved at compile time.
+ */
+template <SetPolicy policy>
+class SetAssociativeCache
+{
+private:
+    uint32_t sets;
+    uint32_t ways;
+    uint32_t stride;   // ways rounded up to a multiple of 8
+    uint32_t setBits;  // log2(sets)
+    uint32_t *tags;    // tags[set * stride + way]
+    uint32_t *valid;   // valid[set] = bitmask of valid ways
+    uint32_t *stamps;  // SET_LRU: last use time of each way
+    uint32_t *order;   // SET_FIFO: next way to replace, SET_PLRU: tree bits
+    uint32_t clock;    // SET_LRU: current time
+    uint32_t random;   // SET_RANDOM: xorshift state
+    uint32_t foundSet; // set and way of element found by last successful lookup
+    uint32_t foundWay;
+
+    /**
+     * Bitmask of ways of set whose tag equals tag
+     */
+    uint32_t probe(uint32_t set, uint32_t tag) const
+    {
+        const uint32_t *t = tags + set * stride;
+        uint32_t mask = 0;
+#if defined(__AVX2__)
+        __m256i needle = _mm256_set1_epi32(tag);
+        for (uint32_t w = 0; w < ways; w += 8)
+        {
+            __m256i eq = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(t + w)), needle);
+            mask |= (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(eq)) << w;
+        }
+#elif defined(__SSE2__)
+        __m128i needle = _mm_set1_epi32(tag);
+        for (uint32_t w = 0; w < ways; w += 4)
+        {
+            __m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(t + w)), needle);
+            mask |= (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(eq)) << w;
+        }
+#else
+        for (uint32_t w = 0; w < ways; w++)
+        {
+            mask |= (uint32_t)(t[w] == tag) << w;
+        }
+#endif
+        return mask & valid[set];
+    }
+
+    /**
+     * Update replacement state of set on use of way
+     */
+    void access(uint32_t set, uint32_t way)
+    {
+        if (policy == SET_LRU)
+        {
+            stamps[set * ways + way] = ++clock;
+        }
+        else if (policy == SET_PLRU)
+        {
+            // point every node on the path away from way
+            uint32_t node = 1;
+            for (uint32_t bit = ways >> 1; bit > 0; bit >>= 1)
+            {
+                uint32_t right = (way & bit) != 0;
+                order[set] = (order[set] & ~(1u << node)) | ((right ^ 1) << node);
+                node = 2 * node + right;
+            }
+        }
+    }
+
+public:
+    /**
+     * Constructor, sets must be a power of 2 and ways at most 32
+     */
+    SetAssociativeCache(uint32_t sets, uint32_t ways)
+        : sets(sets), ways(ways), stride((ways + 7) & ~7u), setBits(0), clock(0), random(2463534242u), foundSet(0), foundWay(0)
+    {
+        while ((1u << setBits) < sets)
+        {
+            setBits++;
+        }
+        tags = new uint32_t[sets * stride]();
+        valid = new uint32_t[sets]();
+        stamps = new uint32_t[sets * ways]();
+        order = new uint32_t[sets]();
+    }
+
+    /**
+     * Check if element is in Cache
+     */
+    bool lookup(uint32_t data)
+    {
+        foundSet = data & (sets - 1);
+        uint32_t mask = probe(foundSet, data >> setBits);
+        if (mask == 0)
+            return false;
+        foundWay = __builtin_ctz(mask);
+        return true;
+    }
+
+    /**
+     * Update replacement state on a hit
+     */
+    void touch(uint32_t data, uint32_t i)
+    {
+        access(foundSet, foundWay);
+    }
+
+    /**
+     * Evict element from full set according to the set policy, returns the freed way
+     */
+    uint32_t evict(uint32_t set)
+    {
+        uint32_t way = 0;
+        if (policy == SET_LRU)
+        {
+            for (uint32_t w = 1; w < ways; w++)
+            {
+                if (stamps[set * ways + w] < stamps[set * ways + way])
+                {
+                    way = w;
+                }
+            }
+        }
+        else if (policy == SET_FIFO)
+        {
+            way = order[set];
+            order[set] = (way + 1) % ways;
+        }
+        else if (policy == SET_RANDOM)
+        {
+            random ^= random << 13;
+            random ^= random >> 17;
+            random ^= random << 5;
+            way = random % ways;
+        }
+        else
+        {
+            uint32_t node = 1;
+            while (node < ways)
+            {
+                node = 2 * node + ((order[set] >> node) & 1);
+            }
+            way = node - ways;
+        }
+        valid[set] &= ~(1u << way);
+        return way;
+    }
+
+    /**
+     * Insert element in Cache, filling an invalid way before evicting
+     * Returns true and sets victim if a valid element was evicted
+     */
+    bool insert(uint32_t data, uint32_t i, uint32_t &victim)
+    {
+        uint32_t set = data & (sets - 1);
+        uint32_t full = ways == 32 ? 0xFFFFFFFFu : (1u << ways) - 1;
+        uint32_t way;
+        bool evicted = valid[set] == full;
+        if (!evicted)
+        {
+            way = __builtin_ctz(~valid[set]);
+        }
+        else
+        {
+            way = evict(set);
+            victim = (tags[set * stride + way] << setBits) | set;
+        }
+        tags[set * stride + way] = data >> setBits;
+        valid[set] |= 1u << way;
+        access(set, way);
+        return evicted;
+    }
+
+    /**
+     * Insert element in Cache
+     */
+    void insert(uint32_t data, uint32_t i)
+    {
+        uint32_t victim = 0;
+        insert(data, i, victim);
+    }
+
+    /**
+     * Remove element from Cache if present
+     */
+    void invalidate(uint32_t data)
+    {
+        if (lookup(data))
+        {
+            valid[foundSet] &= ~(1u << foundWay);
+        }
+    }
+
+    /**
+     * Destructor
+     */
+    ~SetAssociativeCache()
+    {
+        delete[] tags;
+        delete[] valid;
+        delete[] stamps;
+        delete[] order;
+    }
+};
+
+/**
+ * Returns true if n is power of 2
+ */
+bool isPowerOfTwo(uint32_t n)
+{
+    return (n & (n - 1)) == 0;
+}
+
+/**
+ * Return which power of 2 is n
+ */
+uint32_t getPowerOfTwo(uint32_t n)
+{
+    uint32_t p = 0;
+    while (n > 1)
+    {
+        n = n >> 1;
+        p++;
+    }
+    return p;
+}
+
+/**
+ * Parse Hexadecimal address in [begin, end) to uint32_t
+ *
+ * Accepts both cases of hex letters: the low nibble of '0'-'9' is the digit and the
+ * low nibble of 'A'-'F' / 'a'-'f' is the digit minus 9, so no branch per digit.
+ */
+uint32_t parseHex(const char *begin, const char *end)
+{
+    uint32_t ans = 0;
+    for (const char *c = begin; c < end; c++)
+    {
+        uint32_t t = (*c & 0xF) + 9 * ((*c >> 6) & 1);
+        ans = ans * 16 + t;
+    }
+    return ans;
+}
+
+#ifdef __SSE4_2__
+/**
+ * Parse Hexadecimal address at p using SSE4.2, 16 bytes at p must be readable
+ *
+ * Finds the token length with one range compare, converts all 16 bytes to nibbles at
+ * once, right-aligns the last 8 digits with a shuffle and packs nibble pairs to bytes.
+ * Sets len to the number of hex digits, returns false if the token has 16 or more
+ * digits (caller falls back to the scalar parser). Enabled with -msse4.2 or -march=native.
+ */
+inline bool parseHexSIMD(const char *p, uint32_t &ans, uint32_t &len)
+{
+    const __m128i ranges = _mm_setr_epi8('0', '9', 'A', 'F', 'a', 'f', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    __m128i chunk = _mm_loadu_si128((const __m128i *)p);
+    len = _mm_cmpistri(ranges, chunk, _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_NEGATIVE_POLARITY);
+    if (len >= 16)
+        return false;
+
+    // nibble = low 4 bits, plus 9 for letters
+    __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8('9')), _mm_set1_epi8(9));
+    __m128i nibbles = _mm_add_epi8(_mm_and_si128(chunk, _mm_set1_epi8(0xF)), letters);
+
+    // move digits [len-8, len) to bytes 0..7, zero fill for shorter tokens
+    __m128i shuffle = _mm_add_epi8(_mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 0, 0, 0, 0, 0, 0, 0, 0), _mm_set1_epi8(len - 8));
+    shuffle = _mm_or_si128(shuffle, _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, -128, -128, -128, -128, -128, -128, -128, -128));
+    nibbles = _mm_shuffle_epi8(nibbles, shuffle);
+
+    // combine nibble pairs to bytes, most significant first
+    __m128i bytes = _mm_maddubs_epi16(nibbles, _mm_setr_epi8(16, 1, 16, 1, 16, 1, 16, 1, 0, 0, 0, 0, 0, 0, 0, 0));
+    bytes = _mm_packus_epi16(bytes, bytes);
+    ans = __builtin_bswap32((uint32_t)_mm_cvtsi128_si32(bytes));
+    return true;
+}
+#endif
+
+/**
+ * Binary trace format (.tlbtrace), all words little-endian uint32
+ *
+ *   file:       "TLBT" version T testcase[T]
+ *   testcase:   S P K N block[ceil(N / TLBTRACE_BLOCK)]
+ *   block:      count length byte[length]
+ *
+ * S, P and K are stored exactly as in the text format. The bytes of a block are the
+ * zigzag-varint encoded differences between consecutive addresses, starting from 0
+ * in every block so that blocks decode independently.
+ */
+const char TLBTRACE_MAGIC[4] = {'T', 'L', 'B', 'T'};
+const uint32_t TLBTRACE_VERSION = 1;
+const uint32_t TLBTRACE_BLOCK = 4096;
+
+/**
+ * Append little-endian 32 bit word to buffer
+ */
+void writeWord(vector<unsigned char> &out, uint32_t word)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        out.push_back((word >> (8 * i)) & 0xFF);
+    }
+}
+
+/**
+ * Append addresses M[0..count) to buffer as one .tlbtrace block
+ */
+void writeBlock(vector<unsigned char> &out, uint32_t *M, uint32_t count)
+{
+    vector<unsigned char> bytes;
+    uint32_t prev = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        int32_t delta = (int32_t)(M[i] - prev);
+        uint32_t v = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31); // zigzag encode
+        while (v >= 0x80)
+        {
+            bytes.push_back((v & 0x7F) | 0x80);
+            v >>= 7;
+        }
+        bytes.push_back(v);
+        prev = M[i];
+    }
+    writeWord(out, count);
+    writeWord(out, bytes.size());
+    out.insert(out.end(), bytes.begin(), bytes.end());
+}
+
+/**
+ * Zero-copy reader for the input trace
+ *
+ * If the input is a regular file it is memory mapped and tokens are parsed straight
+ * out of the mapped bytes. Otherwise (pipes, terminals) it is read in fixed-size
+ * chunks into a single reusable buffer. No memory is allocated per token. Input
+ * starting with the .tlbtrace magic is decoded as binary instead of tokenized.
+ */
+class TraceReader
+{
+private:
+    static const size_t CHUNK_SIZE = 1 << 20; // 1MB
+    static const size_t MAX_TOKEN = 64;       // longest token guaranteed to be contiguous
+
+    int fd;
+    const char *cur;
+    const char *end;
+    void *mapped; // mapped file, NULL if reading in chunks
+    size_t mappedSize;
+    char *buffer; // chunk buffer, NULL if mapped
+    bool eof;
+    bool binary; // input is in .tlbtrace format
+
+    /**
+     * Move unread bytes to front of buffer and read next chunk
+     */
+    void refill()
+    {
+        if (mapped != NULL || eof)
+            return;
+        size_t remaining = end - cur;
+        memmove(buffer, cur, remaining);
+        size_t filled = remaining;
+        while (filled < CHUNK_SIZE)
+        {
+            ssize_t r = read(fd, buffer + filled, CHUNK_SIZE - filled);
+            if (r <= 0)
+            {
+                eof = true;
+                break;
+            }
+            filled += r;
+        }
+        cur = buffer;
+        end = buffer + filled;
+    }
+
+    /**
+     * Skip whitespace and make sure the next token is contiguous in memory
+     */
+    void skipWhitespace()
+    {
+        while (true)
+        {
+            while (cur < end && (unsigned char)*cur <= ' ')
+            {
+                cur++;
+            }
+            if ((size_t)(end - cur) >= MAX_TOKEN || eof || mapped != NULL)
+                return;
+            refill();
+            if (cur == end)
+                return;
+        }
+    }
+
+    /**
+     * Make sure the next n bytes are contiguous in memory (if available)
+     */
+    void ensure(size_t n)
+    {
+        if ((size_t)(end - cur) < n)
+        {
+            refill();
+        }
+    }
+
+    /**
+     * Read raw little-endian 32 bit word (0 at end of input)
+     */
+    uint32_t readWord()
+    {
+        ensure(4);
+        if (end - cur < 4)
+        {
+            cur = end;
+            return 0;
+        }
+        uint32_t word;
+        memcpy(&word, cur, 4);
+        cur += 4;
+        return word;
+    }
+
+    /**
+     * Decode one block of zigzag-varint deltas into M, returns number of addresses read
+     */
+    uint32_t readBlock(uint32_t *M, uint32_t maxCount)
+    {
+        uint32_t count = readWord();
+        uint32_t length = readWord();
+        ensure(length);
+        if (count > maxCount || (size_t)(end - cur) < length)
+        {
+            cerr << "Corrupt .tlbtrace block\n";
+            exit(1);
+        }
+        const unsigned char *p = (const unsigned char *)cur;
+        uint32_t prev = 0;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            uint32_t v = 0;
+            uint32_t shift = 0;
+            unsigned char b;
+            do
+            {
+                b = *p++;
+                v |= (uint32_t)(b & 0x7F) << shift;
+                shift += 7;
+            } while ((b & 0x80) && shift < 35);
+            prev += (v >> 1) ^ (0 - (v & 1)); // zigzag decode
+            M[i] = prev;
+        }
+        cur += length;
+        return count;
+    }
+
+    /**
+     * Detect .tlbtrace input by its magic and consume the file header
+     */
+    void detectFormat()
+    {
+        ensure(8);
+        if (end - cur >= 8 && memcmp(cur, TLBTRACE_MAGIC, 4) == 0)
+        {
+            cur += 4;
+            binary = true;
+            uint32_t version = readWord();
+            if (version != TLBTRACE_VERSION)
+            {
+                cerr << "Unsupported .tlbtrace version " << version << "\n";
+                exit(1);
+            }
+        }
+    }
+
+    /**
+     * Parse leading decimal digits of [begin, end)
+     */
+    static uint32_t parseDecimal(const char *begin, const char *end)
+    {
+        uint32_t ans = 0;
+        for (const char *c = begin; c < end && *c >= '0' && *c <= '9'; c++)
+        {
+            ans = ans * 10 + (*c - '0');
+        }
+        return ans;
+    }
+
+    /**
+     * Return end of token starting at cur
+     */
+    const char *tokenEnd()
+    {
+        const char *p = cur;
+        while (p < end && (unsigned char)*p > ' ')
+        {
+            p++;
+        }
+        return p;
+    }
+
+public:
+    /**
+     * Constructor
+     */
+    TraceReader(int fd) : fd(fd), cur(NULL), end(NULL), mapped(NULL), mappedSize(0), buffer(NULL), eof(false), binary(false)
+    {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+        {
+            void *ptr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (ptr != MAP_FAILED)
+            {
+                madvise(ptr, st.st_size, MADV_SEQUENTIAL);
+                mapped = ptr;
+                mappedSize = st.st_size;
+                cur = (const char *)ptr;
+                end = cur + st.st_size;
+            }
+        }
+        if (mapped == NULL)
+        {
+            // fall back to reading in chunks
+            buffer = new char[CHUNK_SIZE];
+            cur = end = buffer;
+            refill();
+        }
+        detectFormat();
+    }
+
+    /**
+     * Read unsigned integer: decimal token, or raw word in .tlbtrace (0 at end of input)
+     */
+    uint32_t readUnsigned()
+    {
+        if (binary)
+            return readWord();
+        skipWhitespace();
+        const char *e = tokenEnd();
+        uint32_t ans = parseDecimal(cur, e);
+        cur = e;
+        return ans;
+    }
+
+    /**
+     * Read hexadecimal address (0 at end of input)
+     */
+    uint32_t readHex()
+    {
+        skipWhitespace();
+#ifdef __SSE4_2__
+        uint32_t value, len;
+        if (end - cur >= 16 && parseHexSIMD(cur, value, len))
+        {
+            cur += len;
+            cur = tokenEnd();
+            return value;
+        }
+#endif
+        const char *e = tokenEnd();
+        uint32_t ans = parseHex(cur, e);
+        cur = e;
+        return ans;
+    }
+
+    /**
+     * Read N ASID tagged addresses into M and asids
+     *
+     * An entry is "ASID:ADDR" or just "ADDR" for the current ASID, and a token "#ASID"
+     * switches the current ASID without being counted as an entry (ASIDs are decimal).
+     * .tlbtrace input carries no ASIDs, so every entry gets ASID 0.
+     */
+    void readTaggedAddresses(uint32_t *M, uint32_t *asids, uint32_t N)
+    {
+        if (binary)
+        {
+            readAddresses(M, N);
+            memset(asids, 0, N * sizeof(uint32_t));
+            return;
+        }
+        uint32_t current = 0;
+        for (uint32_t i = 0; i < N;)
+        {
+            skipWhitespace();
+            if (cur == end)
+            {
+                M[i] = 0;
+                asids[i++] = current;
+                continue;
+            }
+            const char *e = tokenEnd();
+            if (*cur == '#')
+            {
+                current = parseDecimal(cur + 1, e);
+                cur = e;
+                continue;
+            }
+            const char *colon = (const char *)memchr(cur, ':', e - cur);
+            asids[i] = current;
+            if (colon != NULL)
+            {
+                asids[i] = parseDecimal(cur, colon);
+                cur = colon + 1;
+            }
+            M[i++] = parseHex(cur, e);
+            cur = e;
+        }
+    }
+
+    /**
+     * Read N addresses into M, as hex tokens or as .tlbtrace blocks
+     */
+    void readAddresses(uint32_t *M, uint32_t N)
+    {
+        if (!binary)
+        {
+            for (uint32_t i = 0; i < N; i++)
+            {
+                M[i] = readHex();
+            }
+            return;
+        }
+        for (uint32_t i = 0; i < N;)
+        {
+            i += readBlock(M + i, N - i);
+        }
+    }
+
+    /**
+     * Destructor
+     */
+    ~TraceReader()
+    {
+        if (mapped != NULL)
+        {
+            munmap(mapped, mappedSize);
+        }
+        delete[] buffer;
+    }
+};
+
+TraceReader *input; // reader for standard input
+
+/**
+ * Get Virtual Page Number
+ */
+uint32_t getVirtualPageNumber(uint32_t addr, uint32_t S, uint32_t P)
+{
+    return (addr & (S - 1)) >> P;
+}
+
+/**
+ * Virtual Page Numbers of N addresses, 8 (AVX2) or 4 (SSE2, NEON) addresses at a time
+ *
+ * keys may be M itself, so the trace can be converted in place.
+ */
+void computeVPNs(const uint32_t *M, uint32_t N, uint32_t S, uint32_t P, uint32_t *keys)
+{
+    uint32_t i = 0;
+#if defined(__AVX2__)
+    __m256i mask = _mm256_set1_epi32(S - 1);
+    __m128i shift = _mm_cvtsi32_si128(P);
+    for (; i + 8 <= N; i += 8)
+    {
+        __m256i addr = _mm256_loadu_si256((const __m256i *)(M + i));
+        _mm256_storeu_si256((__m256i *)(keys + i), _mm256_srl_epi32(_mm256_and_si256(addr, mask), shift));
+    }
+#elif defined(__SSE2__)
+    __m128i mask = _mm_set1_epi32(S - 1);
+    __m128i shift = _mm_cvtsi32_si128(P);
+    for (; i + 4 <= N; i += 4)
+    {
+        __m128i addr = _mm_loadu_si128((const __m128i *)(M + i));
+        _mm_storeu_si128((__m128i *)(keys + i), _mm_srl_epi32(_mm_and_si128(addr, mask), shift));
+    }
+#elif defined(__ARM_NEON)
+    uint32x4_t mask = vdupq_n_u32(S - 1);
+    int32x4_t shift = vdupq_n_s32(-(int32_t)P); // negative shift is a right shift
+    for (; i + 4 <= N; i += 4)
+    {
+        vst1q_u32(keys + i, vshlq_u32(vandq_u32(vld1q_u32(M + i), mask), shift));
+    }
+#endif
+    for (; i < N; i++)
+    {
+        keys[i] = getVirtualPageNumber(M[i], S, P);
+    }
+}
+
+/**
+ * Address range [start, end) mapped with its own page size
+ */
+struct PageRegion
+{
+    uint32_t start;
+    uint64_t end;
+    uint32_t shift;     // log2(page size in bytes)
+    uint32_t sizeClass; // 1..3, 0 is the base page size P
+};
+
+vector<PageRegion> pageRegions; // sorted by start, non-overlapping
+const uint32_t NUM_SIZE_CLASSES = 4;
+const uint32_t SIZE_CLASS_SHIFT = 30; // size class is stored in the top 2 bits of a key
+
+/**
+ * Load page map file with lines "START END SIZE"
+ *
+ * START and END are hex addresses (END exclusive), SIZE is a page size such as 4K, 2M
+ * or 1G. At most 3 distinct sizes are allowed; addresses outside every region use P.
+ */
+void loadPageMap(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+    {
+        perror(path);
+        exit(1);
+    }
+    vector<uint32_t> sizes;
+    unsigned long long start, end, size;
+    char unit;
+    int line = 0;
+    int r;
+    while ((r = fscanf(fp, "%llx %llx %llu%c", &start, &end, &size, &unit)) == 4)
+    {
+        line++;
+        if (unit == 'K' || unit == 'k')
+            size <<= 10;
+        else if (unit == 'M' || unit == 'm')
+            size <<= 20;
+        else if (unit == 'G' || unit == 'g')
+            size <<= 30;
+        PageRegion region;
+        region.start = start;
+        region.end = end;
+        region.shift = getPowerOfTwo(size);
+        if (start >= end || end > (1ull << 32) || size == 0 || size > (1ull << 31) || !isPowerOfTwo(size))
+        {
+            cerr << path << ": invalid region on line " << line << "\n";
+            exit(1);
+        }
+        uint32_t c = find(sizes.begin(), sizes.end(), (uint32_t)size) - sizes.begin();
+        if (c == sizes.size())
+        {
+            sizes.push_back(size);
+        }
+        if (sizes.size() >= NUM_SIZE_CLASSES)
+        {
+            cerr << path << ": at most " << NUM_SIZE_CLASSES - 1 << " page sizes are supported\n";
+            exit(1);
+        }
+        region.sizeClass = c + 1;
+        pageRegions.push_back(region);
+    }
+    if (r != EOF)
+    {
+        cerr << path << ": invalid region on line " << line + 1 << "\n";
+        exit(1);
+    }
+    fclose(fp);
+    sort(pageRegions.begin(), pageRegions.end(), [](const PageRegion &a, const PageRegion &b)
+         { return a.start < b.start; });
+    for (size_t j = 1; j < pageRegions.size(); j++)
+    {
+        if (pageRegions[j].start < pageRegions[j - 1].end)
+        {
+            cerr << path << ": overlapping regions\n";
+            exit(1);
+        }
+    }
+}
+
+/**
+ * Translate each address of M with the page size of its region
+ *
+ * The key of an address is its page number under that page size, tagged with the size
+ * class in the top 2 bits, so entries of different page sizes coexist in one TLB. Page
+ * numbers fit below bit 30 because P is at least 1KB. keys may be M itself.
+ */
+void translateMixed(const uint32_t *M, uint32_t N, uint32_t S, uint32_t P, uint32_t *keys)
+{
+    for (uint32_t i = 0; i < N; i++)
+    {
+        uint32_t shift = P;
+        uint32_t sizeClass = 0;
+        auto it = upper_bound(pageRegions.begin(), pageRegions.end(), M[i], [](uint32_t addr, const PageRegion &r)
+                              { return addr < r.start; });
+        if (it != pageRegions.begin() && M[i] < (--it)->end)
+        {
+            shift = it->shift;
+            sizeClass = it->sizeClass;
+        }
+        keys[i] = getVirtualPageNumber(M[i], S, shift) | (sizeClass << SIZE_CLASS_SHIFT);
+    }
+}
+
+/**
+ * Number of points in a time series over N references, one every options.statsInterval
+ */
+uint32_t numIntervals(uint32_t N)
+{
+    return N / options.statsInterval + (N % options.statsInterval != 0);
+}
+
+/**
+ * Simulate a replacement policy over N keys (page numbers), returns number of cache hits
+ *
+ * Policy is any cache providing
+ *   bool lookup(key)     true if key is in the cache
+ *   void touch(key, i)   update policy state on a hit at trace index i (after lookup)
+ *   void insert(key, i)  add key on a miss at trace index i, calling evict() when full
+ *   evict()              remove the element chosen by the policy
+ * Dispatch is static, so the whole loop is inlined for every policy. If series is not
+ * NULL the cumulative hit count after every options.statsInterval references is stored
+ * in it, one entry per (possibly partial) interval.
+ */
+template <typename Policy>
+uint32_t simulate(Policy &cache, const uint32_t *keys, uint32_t N, uint32_t *series = NULL)
+{
+    // with series, the hits so far are recorded every options.statsInterval references
+    uint32_t interval = series != NULL ? options.statsInterval : N;
+    uint32_t cacheHit = 0;
+    for (uint32_t begin = 0; begin < N; begin = N - begin > interval ? begin + interval : N)
+    {
+        uint32_t end = N - begin > interval ? begin + interval : N;
+        for (uint32_t i = begin; i < end; i++)
+        {
+            uint32_t key = keys[i];
+            if (cache.lookup(key))
+            {
+                cacheHit++;
+                cache.touch(key, i);
+            }
+            else
+            {
+                cache.insert(key, i);
+            }
+        }
+        if (series != NULL)
+        {
+            *series++ = cacheHit;
+        }
+    }
+    return cacheHit;
+}
+
+/**
+ * Simulation for FIFO Cache, returns number of cache hits
+ */
+uint32_t FIFO(uint32_t *keys, uint32_t N, uint32_t K, uint32_t *series)
+{
+    FIFOCache cache(K);
+    return simulate(cache, keys, N, series);
+}
+
+/**
+ * Simulation for LIFO Cache, returns number of cache hits
+ */
+uint32_t LIFO(uint32_t *keys, uint32_t N, uint32_t K, uint32_t *series)
+{
+    LIFOCache cache(K);
+    return simulate(cache, keys, N, series);
+}
+
+/**
+ * Simulation for LRU Cache, returns number of cache hits
+ */
+uint32_t LRU(uint32_t *keys, uint32_t N, uint32_t K, uint32_t *series)
+{
+    LRUCache cache(K);
+    return simulate(cache, keys, N, series);
+}
+
+/**
+ * Simulation for ARC Cache, returns number of cache hits
+ */
+uint32_t ARC(uint32_t *keys, uint32_t N, uint32_t K, uint32_t *series)
+{
+    ARCCache cache(K);
+    return simulate(cache, keys, N, series);
+}
+
+/**
+ * Simulation for CAR Cache, returns number of cache hits
+ */
+uint32_t CAR(uint32_t *keys, uint32_t N, uint32_t K, uint32_t *series)
+{
+    CARCache cache(K);
+    return simulate(cache, keys, N, series);
+}
+
+/**
+ * Simulation for LIRS Cache, returns number of cache hits
+ */
+uint32_t LIRS(uint32_t *keys, uint32_t N, uint32_t K, uint32_t *series)
+{
+    LIRSCache cache(K);
+    return simulate(cache, keys, N, series);
+}
+
+/**
+ * Simulation for 2Q Cache, returns number of cache hits
+ */
+uint32_t TwoQ(uint32_t *keys, uint32_t N, uint32_t K, uint32_t *series)
+{
+    TwoQCache cache(K);
+    return simulate(cache, keys, N, series);
+}
+
+/**
+ * Simulation for CLOCK Cache, returns number of cache hits
+ */
+uint32_t Clock(uint32_t *keys, uint32_t N, uint32_t K, uint32_t *series)
+{
+    ClockCache cache(K);
+    return simulate(cache, keys, N, series);
+}
+
+/**
+ * Simulation for CLOCK-Pro Cache, returns number of cache hits
+ */
+uint32_t ClockPro(uint32_t *keys, uint32_t N, uint32_t K, uint32_t *series)
+{
+    ClockProCache cache(K);
+    return simulate(cache, keys, N, series);
+}
+
+/**
+ * Simulation for W-TinyLFU Cache, returns number of cache hits
+ */
+uint32_t WTinyLFU(uint32_t *keys, uint32_t N, uint32_t K, uint32_t *series)
+{
+    WTinyLFUCache cache(K, !options.tinyLFULRU);
+    return simulate(cache, keys, N, series);
+}
+
+/**
+ * Simulation for a set-associative Cache with options.ways ways and K / ways sets
+ */
+template <SetPolicy policy>
+uint32_t SetAssociative(uint32_t *keys, uint32_t N, uint32_t K, uint32_t *series)
+{
+    SetAssociativeCache<policy> cache(K / options.ways, options.ways);
+    return simulate(cache, keys, N, series);
+}
+
+/**
+ * Simulation of an L1/L2 TLB hierarchy in a single pass over keys
+ *
+ * Inclusive: a page walk fills both levels, an L2 hit fills L1, and an L2 eviction
+ * back-invalidates L1 so L1 stays a subset of L2.
+ * Exclusive: a page walk fills L1 only, an L2 hit moves the entry from L2 to L1, and
+ * L1 victims are written into L2 so no entry is in both levels.
+ * Stores L1 hits, L2 hits and page walks in hits[0..2].
+ */
+template <SetPolicy l1Policy, SetPolicy l2Policy>
+void Hierarchy(uint32_t *keys, uint32_t N, uint32_t *hits)
+{
+    SetAssociativeCache<l1Policy> l1(options.l1.entries / options.l1.ways, options.l1.ways);
+    SetAssociativeCache<l2Policy> l2(options.l2.entries / options.l2.ways, options.l2.ways);
+    uint32_t l1Hit = 0, l2Hit = 0, pageWalk = 0;
+    uint32_t victim = 0;
+    for (uint32_t i = 0; i < N; i++)
+    {
+        uint32_t vpn = keys[i];
+        if (l1.lookup(vpn))
+        {
+            l1Hit++;
+            l1.touch(vpn, i);
+            continue;
+        }
+        if (l2.lookup(vpn))
+        {
+            l2Hit++;
+            if (options.exclusive)
+            {
+                l2.invalidate(vpn);
+            }
+            else
+            {
+                l2.touch(vpn, i);
+            }
+        }
+        else
+        {
+            pageWalk++;
+            if (!options.exclusive && l2.insert(vpn, i, victim))
+            {
+                l1.invalidate(victim);
+            }
+        }
+        if (l1.insert(vpn, i, victim) && options.exclusive)
+        {
+            l2.insert(victim, i);
+        }
+    }
+    hits[0] = l1Hit;
+    hits[1] = l2Hit;
+    hits[2] = pageWalk;
+}
+
+/**
+ * Run Hierarchy instantiated for the L2 policy in options
+ */
+template <SetPolicy l1Policy>
+void HierarchyL2(uint32_t *keys, uint32_t N, uint32_t *hits)
+{
+    switch (options.l2.policy)
+    {
+    case SET_LRU:
+        return Hierarchy<l1Policy, SET_LRU>(keys, N, hits);
+    case SET_FIFO:
+        return Hierarchy<l1Policy, SET_FIFO>(keys, N, hits);
+    case SET_RANDOM:
+        return Hierarchy<l1Policy, SET_RANDOM>(keys, N, hits);
+    case SET_PLRU:
+        return Hierarchy<l1Policy, SET_PLRU>(keys, N, hits);
+    }
+}
+
+/**
+ * Run Hierarchy instantiated for the L1 and L2 policies in options
+ */
+void HierarchyAny(uint32_t *keys, uint32_t N, uint32_t *hits)
+{
+    switch (options.l1.policy)
+    {
+    case SET_LRU:
+        return HierarchyL2<SET_LRU>(keys, N, hits);
+    case SET_FIFO:
+        return HierarchyL2<SET_FIFO>(keys, N, hits);
+    case SET_RANDOM:
+        return HierarchyL2<SET_RANDOM>(keys, N, hits);
+    case SET_PLRU:
+        return HierarchyL2<SET_PLRU>(keys, N, hits);
+    }
+}
+
+/**
+ * Remap the keys to dense ids 0..U-1, returns U
+ *
+ * Indices are radix sorted by VPN (two 16 bit passes), then ids are handed out in
+ * sorted order, so every later per-page table can be a plain array of size U.
+ */
+uint32_t remapDense(const uint32_t *trace, uint32_t N, uint32_t *ids)
+{
+    vector<uint32_t> keys(trace, trace + N), keysTmp(N), order(N), orderTmp(N);
+    for (uint32_t i = 0; i < N; i++)
+    {
+        order[i] = i;
+    }
+    vector<uint32_t> bucket(1 << 16);
+    for (uint32_t pass = 0; pass < 32; pass += 16)
+    {
+        fill(bucket.begin(), bucket.end(), 0);
+        for (uint32_t i = 0; i < N; i++)
+        {
+            bucket[(keys[i] >> pass) & 0xFFFF]++;
+        }
+        uint32_t sum = 0;
+        for (uint32_t &b : bucket)
+        {
+            uint32_t c = b;
+            b = sum;
+            sum += c;
+        }
+        for (uint32_t i = 0; i < N; i++)
+        {
+            uint32_t dst = bucket[(keys[i] >> pass) & 0xFFFF]++;
+            keysTmp[dst] = keys[i];
+            orderTmp[dst] = order[i];
+        }
+        keys.swap(keysTmp);
+        order.swap(orderTmp);
+    }
+
+    uint32_t U = 0;
+    for (uint32_t i = 0; i < N; i++)
+    {
+        if (i > 0 && keys[i] != keys[i - 1])
+        {
+            U++;
+        }
+        ids[order[i]] = U;
+    }
+    return N > 0 ? U + 1 : 0;
+}
+
+/**
+ * Compute index of next occurrence of each dense id (INF if none)
+ */
+uint32_t *computeNextOccurrence(uint32_t *ids, uint32_t N, uint32_t U)
+{
+    const uint32_t INF = 1e9;
+    uint32_t *nextOccurrence = new uint32_t[N];
+    vector<uint32_t> next(U, INF);
+    for (int i = N - 1; i >= 0; i--)
+    {
+        nextOccurrence[i] = next[ids[i]];
+        next[ids[i]] = i;
+    }
+    return nextOccurrence;
+}
+
+/**
+ * Simulation for Optimal Cache, returns number of cache hits
+ */
+uint32_t Optimal(uint32_t *keys, uint32_t N, uint32_t K, uint32_t *series)
+{
+    uint32_t *ids = new uint32_t[N];
+    uint32_t U = remapDense(keys, N, ids);
+    uint32_t *nextOccurrence = computeNextOccurrence(ids, N, U);
+
+    // Simulation for Optimal Cache
+    OptimalCache cache(K, U, nextOccurrence);
+    uint32_t cacheHit = simulate(cache, ids, N, series);
+    delete[] nextOccurrence;
+    delete[] ids;
+    return cacheHit;
+}
+
+/**
+ * LRU hit counts for every TLB size 1..K in a single pass, stored in hits[0..K-1]
+ *
+ * Uses Mattson stack distances: a Fenwick tree marks the last access time of every
+ * page, so the stack distance of an access is the number of marks after the previous
+ * access of the same page. An access with stack distance d hits for every K >= d.
+ */
+void LRUAllK(uint32_t *keys, uint32_t N, uint32_t K, uint32_t *hits)
+{
+    const uint32_t NEVER = 0xFFFFFFFF;
+    uint32_t *ids = new uint32_t[N];
+    uint32_t U = remapDense(keys, N, ids);
+    FenwickTree tree(N);
+    vector<uint32_t> lastAccess(U, NEVER);
+    vector<uint32_t> histogram(K + 1, 0); // histogram[d] = number of accesses at stack distance d
+    for (uint32_t i = 0; i < N; i++)
+    {
+        uint32_t last = lastAccess[ids[i]];
+        if (last != NEVER)
+        {
+            uint32_t distance = tree.prefixSum(i) - tree.prefixSum(last + 1) + 1;
+            if (distance <= K)
+            {
+                histogram[distance]++;
+            }
+            tree.add(last, -1);
+        }
+        lastAccess[ids[i]] = i;
+        tree.add(i, 1);
+    }
+    delete[] ids;
+
+    // hits for size k = accesses with stack distance <= k
+    uint32_t cacheHit = 0;
+    for (uint32_t k = 1; k <= K; k++)
+    {
+        cacheHit += histogram[k];
+        hits[k - 1] = cacheHit;
+    }
+}
+
+/**
+ * Reuse-distance and working-set statistics of a trace
+ */
+struct TraceStats
+{
+    uint32_t uniquePages;
+    uint64_t coldReferences;          // first references, with no reuse distance
+    vector<uint64_t> reuseHistogram;  // [b] = references with reuse distance in [2^b, 2^(b+1))
+    vector<double> meanWorkingSet;    // [w] = mean of W(t, tau) over all t, for tau = statsWindows[w]
+    vector<uint32_t> workingSet;      // [s * windows + w] = W(t, tau) at the end of interval s
+};
+
+/**
+ * Collect reuse-distance and working-set statistics in a single pass
+ *
+ * Reuse distances are LRU stack distances, found as in LRUAllK. The working set
+ * W(t, tau) is the set of distinct pages among the last tau references; the Fenwick tree
+ * marks the last access of every page, so |W(t, tau)| is the number of marks in the
+ * window, sampled every options.statsInterval references. Its mean over all t (Denning's
+ * s(tau)) adds min(gap, tau) for every reference, where gap is the time to the next
+ * reference of the same page or to the end of the trace.
+ */
+void collectTraceStats(uint32_t *keys, uint32_t N, TraceStats &stats)
+{
+    const uint32_t NEVER = 0xFFFFFFFF;
+    const vector<uint32_t> &windows = options.statsWindows;
+    size_t W = windows.size();
+    uint32_t *ids = new uint32_t[N];
+    uint32_t U = remapDense(keys, N, ids);
+    FenwickTree tree(N);
+    vector<uint32_t> lastAccess(U, NEVER);
+    vector<uint64_t> covered(W, 0); // sum of min(gap, tau) per window
+    stats.uniquePages = U;
+    stats.coldReferences = 0;
+    stats.reuseHistogram.assign(32, 0);
+    stats.workingSet.clear();
+    stats.workingSet.reserve(numIntervals(N) * W);
+    for (uint32_t i = 0; i < N; i++)
+    {
+        uint32_t last = lastAccess[ids[i]];
+        if (last != NEVER)
+        {
+            uint32_t distance = tree.prefixSum(i) - tree.prefixSum(last + 1) + 1;
+            stats.reuseHistogram[31 - __builtin_clz(distance)]++;
+            tree.add(last, -1);
+            for (size_t w = 0; w < W; w++)
+            {
+                covered[w] += min(i - last, windows[w]);
+            }
+        }
+        else
+        {
+            stats.coldReferences++;
+        }
+        lastAccess[ids[i]] = i;
+        tree.add(i, 1);
+
+        uint32_t t = i + 1; // references so far
+        if (t % options.statsInterval == 0 || t == N)
+        {
+            for (size_t w = 0; w < W; w++)
+            {
+                stats.workingSet.push_back(tree.prefixSum(t) - tree.prefixSum(t > windows[w] ? t - windows[w] : 0));
+            }
+        }
+    }
+    for (uint32_t u = 0; u < U; u++)
+    {
+        for (size_t w = 0; w < W; w++)
+        {
+            covered[w] += min(N - lastAccess[u], windows[w]);
+        }
+    }
+    delete[] ids;
+
+    // drop empty buckets past the longest reuse distance
+    while (!stats.reuseHistogram.empty() && stats.reuseHistogram.back() == 0)
+    {
+        stats.reuseHistogram.pop_back();
+    }
+    stats.meanWorkingSet.resize(W);
+    for (size_t w = 0; w < W; w++)
+    {
+        stats.meanWorkingSet[w] = N > 0 ? (double)covered[w] / N : 0;
+    }
+}
+
+/**
+ * Optimal hit counts for every TLB size 1..K in a single pass, stored in hits[0..K-1]
+ *
+ * OPT is a stack algorithm, so the contents of a cache of size k are the top k entries
+ * of a priority stack ordered by next use. Each stack entry is identified by its next
+ * occurrence: the page referenced at time i is the entry whose key is i. On a reference
+ * at depth d the page moves to the top and the displaced entries cascade down to depth d,
+ * keeping the earlier next use at each level. The stack is truncated at depth K.
+ */
+void OptimalAllK(uint32_t *keys, uint32_t N, uint32_t K, uint32_t *hits)
+{
+    uint32_t *ids = new uint32_t[N];
+    uint32_t U = remapDense(keys, N, ids);
+    uint32_t *nextOccurrence = computeNextOccurrence(ids, N, U);
+    delete[] ids;
+    vector<uint32_t> stack(K);            // next occurrence of entry at each depth
+    vector<uint32_t> histogram(K + 1, 0); // histogram[d] = number of accesses at stack depth d
+    uint32_t size = 0;
+    for (uint32_t i = 0; i < N; i++)
+    {
+        // find depth of the referenced page (size if not in stack)
+        uint32_t depth = 0;
+        while (depth < size && stack[depth] != i)
+        {
+            depth++;
+        }
+        if (depth < size)
+        {
+            histogram[depth + 1]++;
+        }
+        else if (size < K)
+        {
+            size++;
+        }
+
+        // move referenced page to top, cascade displaced entries down to its old depth
+        // (on a miss with a full stack the entry carried past depth K falls off)
+        uint32_t carry = nextOccurrence[i];
+        for (uint32_t j = 0; j < depth; j++)
+        {
+            if (j == 0 || stack[j] > carry)
+            {
+                swap(stack[j], carry);
+            }
+        }
+        if (depth < size)
+        {
+            stack[depth] = carry;
+        }
+    }
+    delete[] nextOccurrence;
+
+    // hits for size k = accesses with stack depth <= k
+    uint32_t cacheHit = 0;
+    for (uint32_t k = 1; k <= K; k++)
+    {
+        cacheHit += histogram[k];
+        hits[k - 1] = cacheHit;
+    }
+}
+
+/**
+ * SHARDS sampled LRU miss-ratio curve estimation
+ *
+ * A page is sampled iff hash(page) mod 2^24 < threshold, so either every reference to
+ * a page is sampled or none is, and the sampling rate is R = threshold / 2^24. Stack
+ * distances among sampled pages are scaled by 1/R to estimate true distances. Last
+ * access times of tracked pages are kept in a Fenwick tree that is compacted when full,
+ * so memory is proportional to the number of tracked pages, not to the trace length.
+ *
+ * Fixed rate: R is constant, and the histogram gets the SHARDS_adj correction (the gap
+ * between expected and actual sample count is added to the first bucket).
+ * Fixed size: at most maxTracked pages are tracked; when exceeded the pages with the
+ * largest hash are dropped, the threshold is lowered to that hash and the histogram so
+ * far is rescaled by the ratio of new to old rate.
+ */
+class ShardsSampler
+{
+private:
+    static const uint32_t MODULUS = 1 << 24;
+    uint32_t K;
+    uint32_t maxTracked;                     // 0 = fixed rate
+    uint32_t threshold;                      // sample iff hash < threshold
+    uint64_t references;                     // all references seen
+    double samples;                          // (rescaled) number of sampled references
+    vector<double> histogram;                // histogram[d] for scaled distance d in 1..K, histogram[K+1] beyond
+    double coldMisses;                       // (rescaled) first references of sampled pages
+    unordered_map<uint32_t, uint32_t> times; // tracked page -> last access time
+    priority_queue<pair<uint32_t, uint32_t>> byHash; // (hash, page) of tracked pages, fixed size only
+    FenwickTree *tree;                       // marks last access times of tracked pages
+    uint32_t treeSize;
+    uint32_t now;
+
+    /**
+     * Spatial hash of page (murmur3 finalizer) mod 2^24
+     */
+    static uint32_t hash(uint32_t page)
+    {
+        page ^= page >> 16;
+        page *= 0x85EBCA6B;
+        page ^= page >> 13;
+        page *= 0xC2B2AE35;
+        page ^= page >> 16;
+        return page & (MODULUS - 1);
+    }
+
+    /**
+     * Renumber last access times of tracked pages to 0..n-1, growing the tree if needed
+     */
+    void compact()
+    {
+        vector<pair<uint32_t, uint32_t>> order; // (time, page)
+        order.reserve(times.size());
+        for (auto &entry : times)
+        {
+            order.push_back(make_pair(entry.second, entry.first));
+        }
+        sort(order.begin(), order.end());
+        if (order.size() * 2 > treeSize)
+        {
+            treeSize *= 2;
+        }
+        delete tree;
+        tree = new FenwickTree(treeSize);
+        for (uint32_t t = 0; t < order.size(); t++)
+        {
+            times[order[t].second] = t;
+            tree->add(t, 1);
+        }
+        now = order.size();
+    }
+
+    /**
+     * Drop tracked pages with the largest hash until at most maxTracked remain
+     */
+    void shrink()
+    {
+        while (times.size() > maxTracked)
+        {
+            uint32_t newThreshold = byHash.top().first;
+            double ratio = (double)newThreshold / threshold;
+            for (double &h : histogram)
+            {
+                h *= ratio;
+            }
+            coldMisses *= ratio;
+            samples *= ratio;
+            threshold = newThreshold;
+            while (!byHash.empty() && byHash.top().first >= threshold)
+            {
+                uint32_t page = byHash.top().second;
+                byHash.pop();
+                tree->add(times[page], -1);
+                times.erase(page);
+            }
+        }
+    }
+
+public:
+    /**
+     * Constructor
+     */
+    ShardsSampler(uint32_t K, double rate, uint32_t maxTracked)
+        : K(K), maxTracked(maxTracked), references(0), samples(0), histogram(K + 2, 0), coldMisses(0), treeSize(1024), now(0)
+    {
+        threshold = max(1.0, min(1.0, rate) * MODULUS);
+        tree = new FenwickTree(treeSize);
+    }
+
+    /**
+     * Process one reference
+     */
+    void access(uint32_t page)
+    {
+        references++;
+        uint32_t h = hash(page);
+        if (h >= threshold)
+            return;
+        samples++;
+        if (now == treeSize)
+        {
+            compact();
+        }
+        double rate = (double)threshold / MODULUS;
+        auto it = times.find(page);
+        if (it == times.end())
+        {
+            coldMisses++;
+            times[page] = now;
+            if (maxTracked > 0)
+            {
+                byHash.push(make_pair(h, page));
+            }
+        }
+        else
+        {
+            uint32_t distance = tree->prefixSum(now) - tree->prefixSum(it->second + 1) + 1;
+            double scaled = max(1.0, floor(distance / rate));
+            histogram[scaled <= K ? (uint32_t)scaled : K + 1]++;
+            tree->add(it->second, -1);
+            it->second = now;
+        }
+        tree->add(now++, 1);
+        if (maxTracked > 0 && times.size() > maxTracked)
+        {
+            shrink();
+        }
+    }
+
+    /**
+     * Estimated LRU miss ratio and 95% error bar for every TLB size 1..K
+     *
+     * The error bar is the binomial approximation 1.96 * sqrt(m (1 - m) / n) over the n
+     * sampled references; it ignores the extra variance of sampling whole pages.
+     */
+    void missRatioCurve(vector<double> &missRatio, vector<double> &error)
+    {
+        vector<double> h = histogram;
+        double total = samples;
+        if (maxTracked == 0)
+        {
+            // SHARDS_adj: attribute the sample count error to the smallest distance
+            double expected = references * ((double)threshold / MODULUS);
+            h[1] = max(0.0, h[1] + expected - samples);
+            total = coldMisses;
+            for (double count : h)
+            {
+                total += count;
+            }
+        }
+        missRatio.assign(K, 0);
+        error.assign(K, 0);
+        double hitsSoFar = 0;
+        for (uint32_t k = 1; k <= K; k++)
+        {
+            hitsSoFar += h[k];
+            double m = total > 0 ? min(1.0, max(0.0, 1 - hitsSoFar / total)) : 0;
+            missRatio[k - 1] = m;
+            error[k - 1] = samples > 0 ? 1.96 * sqrt(m * (1 - m) / samples) : 0;
+        }
+    }
+
+    /**
+     * Destructor
+     */
+    ~ShardsSampler()
+    {
+        delete tree;
+    }
+};
+
+/**
+ * Print estimated LRU miss ratios for sizes 1..K and their error bars on two lines
+ */
+void printMissRatioCurve(ShardsSampler &sampler, uint32_t K, ostream &out)
+{
+    vector<double> missRatio, error;
+    sampler.missRatioCurve(missRatio, error);
+    out << fixed << setprecision(4);
+    for (uint32_t k = 0; k < K; k++)
+    {
+        out << missRatio[k] << (k == K - 1 ? "\n" : " ");
+    }
+    for (uint32_t k = 0; k < K; k++)
+    {
+        out << error[k] << (k == K - 1 ? "\n" : " ");
+    }
+}
+
+/**
+ * Print SHARDS estimated LRU miss-ratio curve of a test case
+ */
+void ShardsMRC(uint32_t *keys, uint32_t N, uint32_t K, ostream &out)
+{
+    ShardsSampler sampler(K, options.shardsRate, options.shardsMax);
+    for (uint32_t i = 0; i < N; i++)
+    {
+        sampler.access(keys[i]);
+    }
+    printMissRatioCurve(sampler, K, out);
+}
+
+/**
+ * Simulations run for each test case, in output order
+ */
+typedef uint32_t (*Simulation)(uint32_t *keys, uint32_t N, uint32_t K, uint32_t *series);
+const Simulation SIMULATIONS[] = {FIFO, LIFO, LRU, Optimal, ARC, CAR, LIRS, TwoQ, Clock, ClockPro, WTinyLFU};
+const char *const SIMULATION_NAMES[] = {"FIFO", "LIFO", "LRU", "Optimal", "ARC", "CAR",
+                                        "LIRS", "2Q", "CLOCK", "CLOCK-Pro", "W-TinyLFU"};
+const int NUM_SIMULATIONS = sizeof(SIMULATIONS) / sizeof(SIMULATIONS[0]);
+
+/**
+ * Simulations run for each test case with --ways, in output order
+ */
+const Simulation SET_ASSOCIATIVE_SIMULATIONS[] = {SetAssociative<SET_LRU>, SetAssociative<SET_FIFO>,
+                                                  SetAssociative<SET_RANDOM>, SetAssociative<SET_PLRU>};
+const char *const SET_ASSOCIATIVE_NAMES[] = {"set-LRU", "set-FIFO", "set-random", "set-PLRU"};
+const int NUM_SET_ASSOCIATIVE_SIMULATIONS = sizeof(SET_ASSOCIATIVE_SIMULATIONS) / sizeof(SET_ASSOCIATIVE_SIMULATIONS[0]);
+
+/**
+ * Run all simulations and store their hit counts in order
+ *
+ * In parallel mode every simulation runs on its own thread with its own cache over the
+ * shared read-only keys; results are still reported in the order of simulations.
+ * With series, each simulation also records its hit-count time series there.
+ */
+void runSimulations(const Simulation *simulations, int count, uint32_t *keys, uint32_t N, uint32_t K, bool parallel,
+                    uint32_t *hits, uint32_t *series = NULL)
+{
+    uint32_t points = numIntervals(N); // series of simulation j starts at series + j * points
+    if (!parallel)
+    {
+        for (int j = 0; j < count; j++)
+        {
+            hits[j] = simulations[j](keys, N, K, series != NULL ? series + j * points : NULL);
+        }
+        return;
+    }
+    vector<thread> threads;
+    for (int j = 0; j < count; j++)
+    {
+        threads.emplace_back([=]()
+                             { hits[j] = simulations[j](keys, N, K, series != NULL ? series + j * points : NULL); });
+    }
+    for (thread &t : threads)
+    {
+        t.join();
+    }
+}
+
+/**
+ * Run simulations with a separate TLB of K entries per page size class, summing hits
+ */
+void runSplitSimulations(const Simulation *simulations, int count, uint32_t *keys, uint32_t N, uint32_t K,
+                         bool parallel, uint32_t *hits)
+{
+    fill(hits, hits + count, 0);
+    uint32_t *classKeys = new uint32_t[N];
+    for (uint32_t c = 0; c < NUM_SIZE_CLASSES; c++)
+    {
+        uint32_t n = 0;
+        for (uint32_t i = 0; i < N; i++)
+        {
+            if ((keys[i] >> SIZE_CLASS_SHIFT) == c)
+            {
+                classKeys[n++] = keys[i];
+            }
+        }
+        vector<uint32_t> classHits(count);
+        runSimulations(simulations, count, classKeys, n, K, parallel, classHits.data());
+        for (int j = 0; j < count; j++)
+        {
+            hits[j] += classHits[j];
+        }
+    }
+    delete[] classKeys;
+}
+
+/**
+ * Work-stealing thread pool for a fixed batch of independent tasks
+ *
+ * Tasks are dealt round robin to per-worker queues before the workers start. Each
+ * worker pops from the back of its own queue and, once that is empty, steals from the
+ * front of the other queues. Since no task submits new tasks, a worker exits when it
+ * finds every queue empty.
+ */
+class WorkStealingPool
+{
+private:
+    struct WorkerQueue
+    {
+        mutex lock;
+        deque<function<void()>> tasks;
+    };
+    vector<WorkerQueue> queues;
+    uint32_t next; // queue receiving the next submitted task
+
+    /**
+     * Take a task from own queue or steal one, returns false if all queues are empty
+     */
+    bool takeTask(uint32_t self, function<void()> &task)
+    {
+        for (uint32_t k = 0; k < queues.size(); k++)
+        {
+            WorkerQueue &q = queues[(self + k) % queues.size()];
+            lock_guard<mutex> guard(q.lock);
+            if (q.tasks.empty())
+                continue;
+            if (k == 0)
+            {
+                task = move(q.tasks.back());
+                q.tasks.pop_back();
+            }
+            else
+            {
+                task = move(q.tasks.front());
+                q.tasks.pop_front();
+            }
+            return true;
+        }
+        return false;
+    }
+
+public:
+    /**
+     * Constructor
+     */
+    WorkStealingPool(uint32_t numThreads) : queues(numThreads > 0 ? numThreads : 1), next(0) {}
+
+    /**
+     * Submit task (before run)
+     */
+    void submit(function<void()> task)
+    {
+        queues[next].tasks.push_back(move(task));
+        next = (next + 1) % queues.size();
+    }
+
+    /**
+     * Run all submitted tasks and wait for them to finish
+     */
+    void run()
+    {
+        vector<thread> workers;
+        for (uint32_t w = 0; w < queues.size(); w++)
+        {
+            workers.emplace_back([this, w]()
+                                 {
+                                     function<void()> task;
+                                     while (takeTask(w, task))
+                                     {
+                                         task();
+                                     } });
+        }
+        for (thread &t : workers)
+        {
+            t.join();
+        }
+    }
+};
+
+/**
+ * Replace each page number by a dense id of its (ASID, page number) pair
+ *
+ * Entries of different address spaces then never match in any TLB (tagged retention).
+ */
+void tagAddressSpaces(uint32_t *keys, uint32_t *asids, uint32_t N)
+{
+    unordered_map<uint64_t, uint32_t> ids;
+    ids.reserve(N);
+    for (uint32_t i = 0; i < N; i++)
+    {
+        uint64_t key = ((uint64_t)asids[i] << 32) | keys[i];
+        auto it = ids.emplace(key, ids.size()).first;
+        keys[i] = it->second;
+    }
+}
+
+/**
+ * Simulations of a single TLB in the selected mode, with their names
+ */
+int selectSimulations(const Simulation *&simulations, const char *const *&names)
+{
+    if (options.ways > 0)
+    {
+        simulations = SET_ASSOCIATIVE_SIMULATIONS;
+        names = SET_ASSOCIATIVE_NAMES;
+        return NUM_SET_ASSOCIATIVE_SIMULATIONS;
+    }
+    simulations = SIMULATIONS;
+    names = SIMULATION_NAMES;
+    return NUM_SIMULATIONS;
+}
+
+/**
+ * Run the simulations of the selected mode over keys, storing their hit counts in hits
+ *
+ * If series is not NULL it receives the hit-count time series of every simulation, one
+ * after another (see runSimulations); it is left empty in modes without one.
+ */
+void simulateTrace(uint32_t *keys, uint32_t N, uint32_t K, vector<uint32_t> &hits, vector<uint32_t> *series = NULL)
+{
+    if (options.allK)
+    {
+        hits.resize(2 * K);
+        LRUAllK(keys, N, K, hits.data());
+        OptimalAllK(keys, N, K, hits.data() + K);
+        return;
+    }
+    if (options.hierarchy)
+    {
+        hits.resize(3);
+        HierarchyAny(keys, N, hits.data());
+        return;
+    }
+
+    const Simulation *simulations;
+    const char *const *names;
+    int count = selectSimulations(simulations, names);
+    hits.resize(count);
+    if (options.splitTLB && !pageRegions.empty())
+    {
+        runSplitSimulations(simulations, count, keys, N, K, options.parallel, hits.data());
+    }
+    else if (series != NULL)
+    {
+        series->resize(count * numIntervals(N));
+        runSimulations(simulations, count, keys, N, K, options.parallel, hits.data(), series->data());
+    }
+    else
+    {
+        runSimulations(simulations, count, keys, N, K, options.parallel, hits.data());
+    }
+}
+
+/**
+ * Test case as read from input
+ */
+struct TestCase
+{
+    uint32_t S; // in MB
+    uint32_t P; // in KB
+    uint32_t K;
+    uint32_t N;
+    uint32_t *M;
+    uint32_t *asids; // ASID of each entry, NULL without --asid
+    uint32_t index;  // position in the input
+    string stats;    // --stats records of this test case
+};
+
+/**
+ * Read a test case
+ */
+void readTestCase(TestCase &tc)
+{
+    tc.S = input->readUnsigned();
+    tc.P = input->readUnsigned();
+    tc.K = input->readUnsigned();
+    tc.N = input->readUnsigned();
+    static uint32_t count = 0;
+    tc.index = count++;
+    tc.M = new uint32_t[tc.N]; // allocate array of length N on heap
+    tc.asids = NULL;
+    if (options.asid)
+    {
+        tc.asids = new uint32_t[tc.N];
+        input->readTaggedAddresses(tc.M, tc.asids, tc.N);
+    }
+    else
+    {
+        input->readAddresses(tc.M, tc.N);
+    }
+}
+
+FILE *statsFile = NULL;   // --stats output
+bool statsFirstRecord = true;
+
+/**
+ * Open the --stats file and write the CSV header or start the JSON array
+ */
+void openStats(const char *path)
+{
+    statsFile = fopen(path, "w");
+    if (statsFile == NULL)
+    {
+        perror(path);
+        exit(1);
+    }
+    fputs(options.statsJSON ? "[" : "test,s,p,metric,t,param,value\n", statsFile);
+}
+
+/**
+ * Append the records of one test case to the --stats file
+ */
+void writeStats(const string &records)
+{
+    if (records.empty())
+    {
+        return;
+    }
+    if (options.statsJSON && !statsFirstRecord)
+    {
+        fputs(",", statsFile);
+    }
+    statsFirstRecord = false;
+    fputs(records.c_str(), statsFile);
+}
+
+/**
+ * Close the --stats file
+ */
+void closeStats()
+{
+    if (options.statsJSON)
+    {
+        fputs("\n]\n", statsFile);
+    }
+    fclose(statsFile);
+}
+
+/**
+ * Format the statistics of a test case simulated with S (in MB) and P (in KB)
+ *
+ * CSV has one row per value: test,s,p,metric,t,param,value where t is the number of
+ * references at the end of a time-series interval and param is the reuse-distance
+ * bucket (its lower bound, or cold), the working-set window tau or the policy name.
+ * hit_rate is the hit rate within each interval. JSON has one object per test case
+ * with the same values, time series as arrays indexed like "t".
+ * series holds the hit-count time series of every simulation, empty if not available.
+ */
+string formatStats(const TestCase &tc, uint32_t s, uint32_t p, const TraceStats &stats, const vector<uint32_t> &series)
+{
+    const vector<uint32_t> &windows = options.statsWindows;
+    uint32_t N = tc.N;
+    uint32_t points = numIntervals(N);
+    vector<uint32_t> t(points); // references at the end of each interval
+    for (uint32_t k = 0; k < points; k++)
+    {
+        t[k] = k + 1 < points ? (k + 1) * options.statsInterval : N;
+    }
+    const Simulation *simulations = NULL;
+    const char *const *names = NULL;
+    int count = series.empty() ? 0 : selectSimulations(simulations, names);
+
+    ostringstream out;
+    out << fixed;
+    if (!options.statsJSON)
+    {
+        string prefix = to_string(tc.index) + "," + to_string(s) + "," + to_string(p) + ",";
+        out << prefix << "references,,," << N << "\n";
+        out << prefix << "unique_pages,,," << stats.uniquePages << "\n";
+        out << prefix << "reuse_distance,,cold," << stats.coldReferences << "\n";
+        for (size_t b = 0; b < stats.reuseHistogram.size(); b++)
+        {
+            out << prefix << "reuse_distance,," << (1u << b) << "," << stats.reuseHistogram[b] << "\n";
+        }
+        for (size_t w = 0; w < windows.size(); w++)
+        {
+            out << prefix << "working_set_mean,," << windows[w] << "," << setprecision(2) << stats.meanWorkingSet[w]
+                << "\n";
+        }
+        for (uint32_t k = 0; k < points; k++)
+        {
+            for (size_t w = 0; w < windows.size(); w++)
+            {
+                out << prefix << "working_set," << t[k] << "," << windows[w] << ","
+                    << stats.workingSet[k * windows.size() + w] << "\n";
+            }
+        }
+        for (int j = 0; j < count; j++)
+        {
+            for (uint32_t k = 0; k < points; k++)
+            {
+                uint32_t hits = series[j * points + k] - (k > 0 ? series[j * points + k - 1] : 0);
+                uint32_t length = t[k] - (k > 0 ? t[k - 1] : 0);
+                out << prefix << "hit_rate," << t[k] << "," << names[j] << "," << setprecision(4)
+                    << (double)hits / length << "\n";
+            }
+        }
+        return out.str();
+    }
+
+    out << "\n{\"test\": " << tc.index << ", \"s\": " << s << ", \"p\": " << p << ", \"references\": " << N
+        << ", \"unique_pages\": " << stats.uniquePages << ",\n \"reuse_distance\": {\"cold\": " << stats.coldReferences;
+    for (size_t b = 0; b < stats.reuseHistogram.size(); b++)
+    {
+        out << ", \"" << (1u << b) << "\": " << stats.reuseHistogram[b];
+    }
+    out << "},\n \"working_set_mean\": {";
+    for (size_t w = 0; w < windows.size(); w++)
+    {
+        out << (w > 0 ? ", \"" : "\"") << windows[w] << "\": " << setprecision(2) << stats.meanWorkingSet[w];
+    }
+    out << "},\n \"t\": [";
+    for (uint32_t k = 0; k < points; k++)
+    {
+        out << (k > 0 ? ", " : "") << t[k];
+    }
+    out << "],\n \"working_set\": {";
+    for (size_t w = 0; w < windows.size(); w++)
+    {
+        out << (w > 0 ? ", \"" : "\"") << windows[w] << "\": [";
+        for (uint32_t k = 0; k < points; k++)
+        {
+            out << (k > 0 ? ", " : "") << stats.workingSet[k * windows.size() + w];
+        }
+        out << "]";
+    }
+    out << "},\n \"hit_rate\": {";
+    for (int j = 0; j < count; j++)
+    {
+        out << (j > 0 ? ",\n  \"" : "\n  \"") << names[j] << "\": [" << setprecision(4);
+        for (uint32_t k = 0; k < points; k++)
+        {
+            uint32_t hits = series[j * points + k] - (k > 0 ? series[j * points + k - 1] : 0);
+            uint32_t length = t[k] - (k > 0 ? t[k - 1] : 0);
+            out << (k > 0 ? ", " : "") << (double)hits / length;
+        }
+        out << "]";
+    }
+    out << "}}";
+    return out.str();
+}
+
+/**
+ * Simulate a test case (already validated, P given as a shift), writing its results to out
+ *
+ * The page numbers of tc.M are computed once into keys (which may be tc.M itself), and
+ * every simulation runs on them.
+ */
+void simulateTestCase(TestCase &tc, uint32_t S, uint32_t P, uint32_t *keys, ostream &out)
+{
+    uint32_t K = tc.K;
+    uint32_t N = tc.N;
+
+    if (!pageRegions.empty())
+    {
+        translateMixed(tc.M, N, S, P, keys); // size-class tagged page numbers
+    }
+    else
+    {
+        computeVPNs(tc.M, N, S, P, keys);
+    }
+
+    if (tc.asids != NULL)
+    {
+        tagAddressSpaces(keys, tc.asids, N);
+    }
+
+    if (options.shardsRate > 0)
+    {
+        ShardsMRC(keys, N, K, out);
+        return;
+    }
+
+    // check K splits into a power of 2 number of sets
+    if (options.ways > 0 && !options.allK && !options.hierarchy &&
+        (K % options.ways != 0 || !isPowerOfTwo(K / options.ways)))
+    {
+        out << "Invalid K = " << K << "\n";
+        return;
+    }
+
+    TraceStats stats;
+    if (options.statsPath != NULL)
+    {
+        collectTraceStats(keys, N, stats);
+    }
+
+    vector<uint32_t> hits;
+    vector<uint32_t> series; // hit-count time series for --stats
+    if (tc.asids != NULL && options.asidFlush)
+    {
+        // a flush empties every TLB, so each run of one ASID is simulated from cold
+        simulateTrace(keys, 0, K, hits);
+        vector<uint32_t> segmentHits;
+        for (uint32_t begin = 0, end = 1; begin < N; begin = end++)
+        {
+            while (end < N && tc.asids[end] == tc.asids[begin])
+            {
+                end++;
+            }
+            simulateTrace(keys + begin, end - begin, K, segmentHits);
+            for (size_t j = 0; j < hits.size(); j++)
+            {
+                hits[j] += segmentHits[j];
+            }
+        }
+    }
+    else
+    {
+        simulateTrace(keys, N, K, hits, options.statsPath != NULL ? &series : NULL);
+    }
+
+    if (options.statsPath != NULL)
+    {
+        if (options.statsJSON && !tc.stats.empty())
+        {
+            tc.stats += ","; // grid mode adds one object per S and P
+        }
+        tc.stats += formatStats(tc, S >> 20, (1u << P) >> 10, stats, series);
+    }
+
+    // all-K mode prints LRU and Optimal hits for sizes 1..K on two lines
+    size_t lineLength = options.allK ? K : hits.size();
+    for (size_t j = 0; j < hits.size(); j++)
+    {
+        out << hits[j] << ((j + 1) % lineLength == 0 ? "\n" : " ");
+    }
+}
+
+/**
+ * Simulate a test case once per (S, P) of the grid, each result prefixed by S and P
+ *
+ * The trace is read once, and each cell computes its page numbers from it into one
+ * shared scratch array.
+ */
+void runGrid(TestCase &tc, ostream &out)
+{
+    uint32_t *keys = new uint32_t[tc.N];
+    vector<uint32_t> gridS = options.gridS.empty() ? vector<uint32_t>(1, tc.S) : options.gridS;
+    vector<uint32_t> gridP = options.gridP.empty() ? vector<uint32_t>(1, tc.P) : options.gridP;
+    for (uint32_t s : gridS)
+    {
+        for (uint32_t p : gridP)
+        {
+            uint32_t S = s << 20; // S = S * 2^20 (S in MB)
+            uint32_t P = p << 10; // P = P * 2^10 (P in KB)
+            out << s << " " << p << " ";
+            if (!isPowerOfTwo(S))
+            {
+                out << "Invalid S = " << s << "\n";
+                continue;
+            }
+            if (!isPowerOfTwo(P))
+            {
+                out << "Invalid P = " << p << "\n";
+                continue;
+            }
+            if (tc.K <= 0)
+            {
+                out << "Invalid K = " << tc.K << "\n";
+                continue;
+            }
+            simulateTestCase(tc, S, getPowerOfTwo(P), keys, out);
         }
-        ans = ans * 16 + t;
     }
-    return ans;
+    delete[] keys;
+    delete[] tc.M;
+    delete[] tc.asids;
 }
 
 /**
- * Get Virtual Page Number
+ * Validate and simulate a test case, writing its results to out
  */
-uint32_t getVirtualPageNumber(uint32_t addr, uint32_t S, uint32_t P)
+void runTestCase(TestCase &tc, ostream &out)
 {
-    return (addr & (S - 1)) >> P;
+    if (!options.gridS.empty() || !options.gridP.empty())
+    {
+        runGrid(tc, out);
+        return;
+    }
+
+    uint32_t S = tc.S << 20; // S = S * 2^20 (S in MB)
+    uint32_t P = tc.P << 10; // P = P * 2^10 (P in KB)
+    uint32_t K = tc.K;
+
+    // check S and P are power of 2
+    if (!isPowerOfTwo(S))
+    {
+        out << "Invalid S = " << (S >> 20) << "\n";
+        return;
+    }
+    if (!isPowerOfTwo(P))
+    {
+        out << "Invalid P = " << (P >> 10) << "\n";
+        return;
+    }
+    // check K is valid
+    if (K <= 0)
+    {
+        out << "Invalid K = " << K << "\n";
+        return;
+    }
+
+    P = getPowerOfTwo(P);
+    simulateTestCase(tc, S, P, tc.M, out); // page numbers replace the addresses in place
+    delete[] tc.M;
+    delete[] tc.asids;
 }
 
 /**
- * Simulation for FIFO Cache
+ * Solve each test case
  */
-void FIFO(uint32_t *M, uint32_t N, uint32_t S, uint32_t P, uint32_t K)
+void solve()
 {
-    FIFOCache cache(K);
-    uint32_t cacheHit = 0;
-    for (int i = 0; i < N; i++)
+    TestCase tc;
+    readTestCase(tc);
+    runTestCase(tc, cout);
+    if (options.statsPath != NULL)
     {
-        uint32_t vpn = getVirtualPageNumber(M[i], S, P);
-        if (cache.checkInCache(vpn))
-        {
-            cacheHit++;
-        }
-        else
+        writeStats(tc.stats);
+    }
+}
+
+/**
+ * Read all T test cases, run them on a work-stealing pool and print results in input order
+ */
+void solveBatch(uint32_t T)
+{
+    vector<TestCase> testCases(T);
+    for (uint32_t i = 0; i < T; i++)
+    {
+        readTestCase(testCases[i]);
+    }
+
+    vector<string> results(T);
+    WorkStealingPool pool(options.jobs > 0 ? options.jobs : thread::hardware_concurrency());
+    for (uint32_t i = 0; i < T; i++)
+    {
+        pool.submit([&testCases, &results, i]()
+                    {
+                        ostringstream out;
+                        runTestCase(testCases[i], out);
+                        results[i] = out.str(); });
+    }
+    pool.run();
+
+    for (uint32_t i = 0; i < T; i++)
+    {
+        cout << results[i];
+        if (options.statsPath != NULL)
         {
-            cache.insertElementInCache(vpn);
+            writeStats(testCases[i].stats);
         }
     }
-    cout << cacheHit << " ";
 }
 
 /**
- * Simulation for LIFO Cache
+ * Optimal simulation over a stream of keys with a lookahead of window references
+ *
+ * A reference is simulated once the window references after it have been read, so its
+ * next use is known if it lies within the window. Memory is O(window + K).
  */
-void LIFO(uint32_t *M, uint32_t N, uint32_t S, uint32_t P, uint32_t K)
+class StreamingOptimal
 {
-    LIFOCache cache(K);
-    uint32_t cacheHit = 0;
-    for (int i = 0; i < N; i++)
+private:
+    uint32_t window;
+    uint32_t mask;       // ring buffers hold the window + 1 unsimulated references
+    uint32_t *keys;      // key of each unsimulated reference
+    uint32_t *nextUse;   // its next use, UNKNOWN if not read yet
+    FlatHashMap lastUse; // key -> latest unsimulated reference to it
+    WindowedOptimalCache cache;
+    uint32_t read;       // references read
+    uint32_t simulated;  // references simulated
+
+    /**
+     * Simulate the oldest unsimulated reference; complete = no more references follow
+     */
+    void step(bool complete)
     {
-        uint32_t vpn = getVirtualPageNumber(M[i], S, P);
-        if (cache.checkInCache(vpn))
+        uint32_t i = simulated++;
+        uint32_t key = keys[i & mask];
+        if (lastUse.find(key) == i)
+        {
+            lastUse.erase(key);
+        }
+        if (cache.lookup(key))
         {
-            cacheHit++;
+            hits++;
+            cache.touch(key, nextUse[i & mask]);
         }
         else
         {
-            cache.insertElementInCache(vpn);
+            guesses += !complete && cache.guessingVictim();
+            cache.insert(key, nextUse[i & mask]);
         }
     }
-    cout << cacheHit << " ";
-}
 
-/**
- * Simulation for LRU Cache
- */
-void LRU(uint32_t *M, uint32_t N, uint32_t S, uint32_t P, uint32_t K)
-{
-    LRUCache cache(K);
-    uint32_t cacheHit = 0;
-    for (int i = 0; i < N; i++)
+public:
+    uint32_t hits;
+    uint32_t guesses; // evictions that chose among elements with next use beyond the window
+
+    /**
+     * Constructor
+     */
+    StreamingOptimal(uint32_t K, uint32_t window)
+        : window(window), lastUse(window + 1), cache(K), read(0), simulated(0), hits(0), guesses(0)
+    {
+        uint32_t ring = 1;
+        while (ring < window + 1)
+        {
+            ring <<= 1;
+        }
+        mask = ring - 1;
+        keys = new uint32_t[ring];
+        nextUse = new uint32_t[ring];
+    }
+
+    /**
+     * Read next reference
+     */
+    void access(uint32_t key)
     {
-        uint32_t vpn = getVirtualPageNumber(M[i], S, P);
-        if (cache.checkInCache(vpn))
+        uint32_t j = read++;
+        uint32_t previous = lastUse.find(key);
+        if (previous != FlatHashMap::NOT_FOUND)
         {
-            cacheHit++;
+            nextUse[previous & mask] = j;
         }
         else
         {
-            cache.insertElementInCache(vpn);
+            cache.reveal(key, j); // previous reference (if any) is simulated already
+        }
+        lastUse.insert(key, j);
+        keys[j & mask] = key;
+        nextUse[j & mask] = WindowedOptimalCache::UNKNOWN;
+        if (read - simulated > window)
+        {
+            step(false);
         }
     }
-    cout << cacheHit << " ";
-}
+
+    /**
+     * Simulate the references left at the end of the trace, whose next uses are exact
+     */
+    void finish()
+    {
+        while (simulated < read)
+        {
+            step(true);
+        }
+    }
+
+    /**
+     * Destructor
+     */
+    ~StreamingOptimal()
+    {
+        delete[] keys;
+        delete[] nextUse;
+    }
+};
 
 /**
- * Simulation for Optimal Cache
+ * Read and simulate one test case in chunks without keeping the trace in memory
+ *
+ * Prints hits in the usual column order, with Optimal using a lookahead of options.window
+ * references, followed by the number of Optimal evictions that had to guess (0 = exact).
+ * With --shards the SHARDS miss-ratio curve is printed instead.
  */
-void Optimal(uint32_t *M, uint32_t N, uint32_t S, uint32_t P, uint32_t K)
+void solveStream()
 {
-    // Compute next occurrence of each element
-    uint32_t *nextOccurrence = new uint32_t[N];
-    unordered_map<uint32_t, uint32_t> mp;
-    mp.reserve(N);
-    const uint32_t INF = 1e9;
-    for (int i = N - 1; i >= 0; i--)
+    static const uint32_t STREAM_CHUNK = 16 * TLBTRACE_BLOCK; // whole .tlbtrace blocks
+    uint32_t S = input->readUnsigned() << 20; // S in MB
+    uint32_t P = input->readUnsigned() << 10; // P in KB
+    uint32_t K = input->readUnsigned();
+    uint32_t N = input->readUnsigned();
+    vector<uint32_t> chunk(min(N, STREAM_CHUNK));
+
+    bool valid = false;
+    if (!isPowerOfTwo(S))
+        cout << "Invalid S = " << (S >> 20) << "\n";
+    else if (!isPowerOfTwo(P))
+        cout << "Invalid P = " << (P >> 10) << "\n";
+    else if (K <= 0)
+        cout << "Invalid K = " << K << "\n";
+    else
+        valid = true;
+    if (!valid)
     {
-        uint32_t vpn = getVirtualPageNumber(M[i], S, P);
-        if (mp.find(vpn) == mp.end())
-        {
-            nextOccurrence[i] = INF;
-        }
-        else
+        // consume the addresses of the test case
+        for (uint32_t done = 0; done < N; done += chunk.size())
         {
-            nextOccurrence[i] = mp[vpn];
+            input->readAddresses(chunk.data(), min(N - done, (uint32_t)chunk.size()));
         }
-        mp[vpn] = i;
+        return;
     }
+    P = getPowerOfTwo(P);
 
-    // Simulation for Optimal Cache
-    OptimalCache heap(K);
-    uint32_t cacheHit = 0;
-    for (int i = 0; i < N; i++)
+    FIFOCache fifo(K);
+    LIFOCache lifo(K);
+    LRUCache lru(K);
+    ARCCache arc(K);
+    CARCache car(K);
+    LIRSCache lirs(K);
+    TwoQCache twoQ(K);
+    ClockCache clock(K);
+    ClockProCache clockPro(K);
+    WTinyLFUCache tinyLFU(K, !options.tinyLFULRU);
+    StreamingOptimal *optimal = options.shardsRate > 0 ? NULL : new StreamingOptimal(K, options.window);
+    ShardsSampler *sampler = options.shardsRate > 0 ? new ShardsSampler(K, options.shardsRate, options.shardsMax) : NULL;
+    uint32_t hits[NUM_SIMULATIONS] = {}; // hits[3] (Optimal) is kept by optimal
+    for (uint32_t done = 0; done < N;)
     {
-        uint32_t vpn = getVirtualPageNumber(M[i], S, P);
-        if (heap.checkInCache(vpn))
+        uint32_t count = min(N - done, (uint32_t)chunk.size());
+        input->readAddresses(chunk.data(), count);
+        done += count;
+        uint32_t *keys = chunk.data();
+        if (!pageRegions.empty())
         {
-            cacheHit++;
-            heap.modifyKey(vpn, nextOccurrence[i]);
+            translateMixed(keys, count, S, P, keys);
         }
         else
         {
-            heap.insertElementInCache(nextOccurrence[i], vpn);
+            computeVPNs(keys, count, S, P, keys);
+        }
+        if (sampler != NULL)
+        {
+            for (uint32_t i = 0; i < count; i++)
+            {
+                sampler->access(keys[i]);
+            }
+            continue;
+        }
+        hits[0] += simulate(fifo, keys, count);
+        hits[1] += simulate(lifo, keys, count);
+        hits[2] += simulate(lru, keys, count);
+        hits[4] += simulate(arc, keys, count);
+        hits[5] += simulate(car, keys, count);
+        hits[6] += simulate(lirs, keys, count);
+        hits[7] += simulate(twoQ, keys, count);
+        hits[8] += simulate(clock, keys, count);
+        hits[9] += simulate(clockPro, keys, count);
+        hits[10] += simulate(tinyLFU, keys, count);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            optimal->access(keys[i]);
         }
     }
-    // delete[] nextOccurrence;
-    cout << cacheHit << "\n";
+
+    if (sampler != NULL)
+    {
+        printMissRatioCurve(*sampler, K, cout);
+        delete sampler;
+        return;
+    }
+    optimal->finish();
+    hits[3] = optimal->hits;
+    for (int j = 0; j < NUM_SIMULATIONS; j++)
+    {
+        cout << hits[j] << " ";
+    }
+    cout << optimal->guesses << "\n";
+    delete optimal;
 }
 
 /**
- * Solve each test case
+ * Convert input trace to .tlbtrace format
  */
-void solve()
+void convertTrace(const char *path)
+{
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL)
+    {
+        perror(path);
+        exit(1);
+    }
+    vector<unsigned char> out;
+    out.insert(out.end(), TLBTRACE_MAGIC, TLBTRACE_MAGIC + 4);
+    writeWord(out, TLBTRACE_VERSION);
+    uint32_t T = input->readUnsigned();
+    writeWord(out, T);
+    for (uint32_t t = 0; t < T; t++)
+    {
+        uint32_t S = input->readUnsigned();
+        uint32_t P = input->readUnsigned();
+        uint32_t K = input->readUnsigned();
+        uint32_t N = input->readUnsigned();
+        writeWord(out, S);
+        writeWord(out, P);
+        writeWord(out, K);
+        writeWord(out, N);
+        uint32_t M[TLBTRACE_BLOCK];
+        for (uint32_t i = 0; i < N; i += TLBTRACE_BLOCK)
+        {
+            uint32_t count = min(TLBTRACE_BLOCK, N - i);
+            input->readAddresses(M, count);
+            writeBlock(out, M, count);
+            fwrite(out.data(), 1, out.size(), fp);
+            out.clear();
+        }
+    }
+    fwrite(out.data(), 1, out.size(), fp);
+    fclose(fp);
+}
+
+/**
+ * Print usage and exit
+ */
+void usage(const char *prog)
 {
-    // Read input
-    uint32_t S, P, K;
-    cin >> S >> P >> K;
+    cerr << "Usage: " << prog << " [--all-k] [--parallel] [--batch] [--jobs N] [--ways W]\n"
+         << "       [--l1 E,W,POLICY --l2 E,W,POLICY [--exclusive]] [--page-map FILE [--split-tlb]]\n"
+         << "       [--asid [--asid-flush]] [--shards R [--shards-max N]]\n"
+         << "       [--tinylfu-lru] [--stream [--window W]] [--grid-s S,... ] [--grid-p P,...] [--convert FILE]\n"
+         << "       [--stats FILE [--stats-format csv|json] [--stats-interval N] [--stats-window T,...]]\n"
+         << "  --all-k         print LRU and Optimal hits for every TLB size 1..K (stack-distance analysis)\n"
+         << "  --parallel      run the policy simulations of each test case on separate threads\n"
+         << "  --batch         read all test cases first, then run them on a work-stealing thread pool\n"
+         << "  --jobs N        thread pool size for --batch (default: number of cores)\n"
+         << "  --ways W        simulate a W-way set-associative TLB with K / W sets (W a power of 2, at most 32)\n"
+         << "                  and print hits for per-set LRU, FIFO, random and tree-PLRU replacement\n"
+         << "  --l1 E,W,POLICY  L1 dTLB of E entries, W ways, POLICY lru|fifo|random|plru (K is ignored)\n"
+         << "  --l2 E,W,POLICY  unified L2 STLB, prints L1 hits, L2 hits and page walks\n"
+         << "  --exclusive     L2 holds only L1 victims (default: inclusive)\n"
+         << "  --page-map FILE  lines \"START END SIZE\" (hex range, size like 2M) translated with their own page size\n"
+         << "  --split-tlb     separate K-entry TLB per page size (default: one unified TLB)\n"
+         << "  --asid          entries are \"ASID:ADDR\" or \"ADDR\", a token \"#ASID\" switches address space;\n"
+         << "                  TLB entries are tagged with their ASID\n"
+         << "  --asid-flush    with --asid, flush the TLB on every context switch instead\n"
+         << "  --shards R      estimate the LRU miss-ratio curve for sizes 1..K from a fraction R of pages\n"
+         << "                  (SHARDS), printing miss ratios and 95% error bars on two lines\n"
+         << "  --shards-max N  with --shards, track at most N pages, lowering the rate as needed\n"
+         << "  --tinylfu-lru   W-TinyLFU admits into a plain LRU main region instead of SLRU\n"
+         << "  --stream        simulate while reading, in memory independent of N: Optimal uses bounded\n"
+         << "                  lookahead and the number of its evictions that had to guess (0 = exact) is\n"
+         << "                  printed last; combines with --page-map and --shards\n"
+         << "  --window W      lookahead of --stream Optimal in references (default 1048576)\n"
+         << "  --grid-s S,...  simulate each test case for every listed S (in MB), reading the trace once\n"
+         << "  --grid-p P,...  ... and every listed P (in KB); each line is prefixed by its S and P\n"
+         << "  --convert FILE  write the input trace to FILE in binary .tlbtrace format and exit\n"
+         << "  --stats FILE    also write to FILE the number of unique pages, a log2-bucketed reuse-distance\n"
+         << "                  histogram, working-set sizes W(t,tau) and per-policy hit rates over time\n"
+         << "  --stats-format F  csv (default) or json\n"
+         << "  --stats-interval N  time series have a point every N references (default 10000)\n"
+         << "  --stats-window T,...  working-set windows tau in references (default 1000,10000,100000)\n";
+    exit(1);
+}
 
-    S = S << 20; // S = S * 2^20 (S in MB)
-    P = P << 10; // P = P * 2^10 (P in KB)
-    uint32_t N;
-    cin >> N;
-    uint32_t *M = new uint32_t[N]; // allocate array of length N on heap
-    for (int i = 0; i < N; i++)
+/**
+ * Parse level config "ENTRIES,WAYS,POLICY", returns false if invalid
+ */
+bool parseLevelConfig(const char *arg, LevelConfig &level)
+{
+    char policy[16];
+    if (sscanf(arg, "%u,%u,%15s", &level.entries, &level.ways, policy) != 3)
+        return false;
+    if (strcmp(policy, "lru") == 0)
+        level.policy = SET_LRU;
+    else if (strcmp(policy, "fifo") == 0)
+        level.policy = SET_FIFO;
+    else if (strcmp(policy, "random") == 0)
+        level.policy = SET_RANDOM;
+    else if (strcmp(policy, "plru") == 0)
+        level.policy = SET_PLRU;
+    else
+        return false;
+    // sets must be a power of 2, PLRU needs a power of 2 number of ways
+    if (level.ways == 0 || level.ways > 32 || level.entries % level.ways != 0)
+        return false;
+    if (level.entries == 0 || !isPowerOfTwo(level.entries / level.ways))
+        return false;
+    return level.policy != SET_PLRU || isPowerOfTwo(level.ways);
+}
+
+/**
+ * Parse comma separated list of unsigned integers, returns false if invalid
+ */
+bool parseList(const char *arg, vector<uint32_t> &values)
+{
+    values.clear();
+    while (true)
     {
-        string addrHex;
-        cin >> addrHex;
-        M[i] = parseHex(addrHex);
+        char *end;
+        unsigned long value = strtoul(arg, &end, 10);
+        if (end == arg || value > 0xFFFFFFFF)
+            return false;
+        values.push_back(value);
+        if (*end == '\0')
+            return true;
+        if (*end != ',')
+            return false;
+        arg = end + 1;
     }
+}
 
-    // check S and P are power of 2
-    if (!isPowerOfTwo(S))
+/**
+ * Parse command line arguments into options
+ */
+void parseArguments(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; i++)
     {
-        cout << "Invalid S = " << (S >> 20) << "\n";
-        return;
+        if (strcmp(argv[i], "--all-k") == 0)
+        {
+            options.allK = true;
+        }
+        else if (strcmp(argv[i], "--parallel") == 0)
+        {
+            options.parallel = true;
+        }
+        else if (strcmp(argv[i], "--batch") == 0)
+        {
+            options.batch = true;
+        }
+        else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc)
+        {
+            options.jobs = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--ways") == 0 && i + 1 < argc)
+        {
+            options.ways = atoi(argv[++i]);
+            if (options.ways == 0 || options.ways > 32 || !isPowerOfTwo(options.ways))
+            {
+                usage(argv[0]);
+            }
+        }
+        else if (strcmp(argv[i], "--l1") == 0 && i + 1 < argc)
+        {
+            if (!parseLevelConfig(argv[++i], options.l1))
+            {
+                usage(argv[0]);
+            }
+            options.hierarchy = true;
+        }
+        else if (strcmp(argv[i], "--l2") == 0 && i + 1 < argc)
+        {
+            if (!parseLevelConfig(argv[++i], options.l2))
+            {
+                usage(argv[0]);
+            }
+            options.hierarchy = true;
+        }
+        else if (strcmp(argv[i], "--exclusive") == 0)
+        {
+            options.exclusive = true;
+        }
+        else if (strcmp(argv[i], "--page-map") == 0 && i + 1 < argc)
+        {
+            options.pageMapPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--split-tlb") == 0)
+        {
+            options.splitTLB = true;
+        }
+        else if (strcmp(argv[i], "--asid") == 0)
+        {
+            options.asid = true;
+        }
+        else if (strcmp(argv[i], "--asid-flush") == 0)
+        {
+            options.asid = true;
+            options.asidFlush = true;
+        }
+        else if (strcmp(argv[i], "--shards") == 0 && i + 1 < argc)
+        {
+            options.shardsRate = atof(argv[++i]);
+            if (options.shardsRate <= 0 || options.shardsRate > 1)
+            {
+                usage(argv[0]);
+            }
+        }
+        else if (strcmp(argv[i], "--shards-max") == 0 && i + 1 < argc)
+        {
+            options.shardsMax = atoi(argv[++i]);
+            if (options.shardsRate == 0)
+            {
+                options.shardsRate = 1;
+            }
+        }
+        else if (strcmp(argv[i], "--tinylfu-lru") == 0)
+        {
+            options.tinyLFULRU = true;
+        }
+        else if (strcmp(argv[i], "--stream") == 0)
+        {
+            options.stream = true;
+        }
+        else if (strcmp(argv[i], "--window") == 0 && i + 1 < argc)
+        {
+            options.stream = true;
+            options.window = atoi(argv[++i]);
+            if (options.window == 0 || options.window >= (1u << 31))
+            {
+                usage(argv[0]);
+            }
+        }
+        else if ((strcmp(argv[i], "--grid-s") == 0 || strcmp(argv[i], "--grid-p") == 0) && i + 1 < argc)
+        {
+            vector<uint32_t> &grid = argv[i][7] == 's' ? options.gridS : options.gridP;
+            if (!parseList(argv[++i], grid))
+            {
+                usage(argv[0]);
+            }
+        }
+        else if (strcmp(argv[i], "--convert") == 0 && i + 1 < argc)
+        {
+            options.convertPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc)
+        {
+            options.statsPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--stats-format") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (strcmp(argv[i], "json") != 0 && strcmp(argv[i], "csv") != 0)
+            {
+                usage(argv[0]);
+            }
+            options.statsJSON = strcmp(argv[i], "json") == 0;
+        }
+        else if (strcmp(argv[i], "--stats-interval") == 0 && i + 1 < argc)
+        {
+            options.statsInterval = atoi(argv[++i]);
+            if (options.statsInterval == 0)
+            {
+                usage(argv[0]);
+            }
+        }
+        else if (strcmp(argv[i], "--stats-window") == 0 && i + 1 < argc)
+        {
+            if (!parseList(argv[++i], options.statsWindows) ||
+                find(options.statsWindows.begin(), options.statsWindows.end(), 0) != options.statsWindows.end())
+            {
+                usage(argv[0]);
+            }
+        }
+        else
+        {
+            usage(argv[0]);
+        }
     }
-    if (!isPowerOfTwo(P))
+    if (options.hierarchy && (options.l1.entries == 0 || options.l2.entries == 0))
     {
-        cout << "Invalid P = " << (P >> 10) << "\n";
-        return;
+        usage(argv[0]); // both levels are required
     }
-    // check K is valid
-    if (K <= 0)
+    if (options.stream && (options.allK || options.batch || options.ways > 0 || options.hierarchy ||
+                           options.splitTLB || options.asid || !options.gridS.empty() || !options.gridP.empty()))
     {
-        cout << "Invalid K = " << K << "\n";
-        return;
+        usage(argv[0]); // these need the whole trace in memory
+    }
+    if (options.statsPath != NULL && (options.stream || options.shardsRate > 0))
+    {
+        usage(argv[0]); // statistics are exact, over the whole trace
     }
-
-    P = getPowerOfTwo(P);
-
-    FIFO(M, N, S, P, K);
-    LIFO(M, N, S, P, K);
-    LRU(M, N, S, P, K);
-    Optimal(M, N, S, P, K);
-
-    delete[] M;
 }
 
 /**
  * Main function
  */
-int main()
+int main(int argc, char *argv[])
 {
-    int T;
-    cin >> T;
-    for (int i = 0; i < T; i++)
+    parseArguments(argc, argv);
+    if (options.pageMapPath != NULL)
+    {
+        loadPageMap(options.pageMapPath);
+    }
+    input = new TraceReader(STDIN_FILENO);
+    if (options.convertPath != NULL)
+    {
+        convertTrace(options.convertPath);
+        delete input;
+        return 0;
+    }
+    int T = input->readUnsigned();
+    if (options.statsPath != NULL)
+    {
+        openStats(options.statsPath);
+    }
+    if (options.stream)
+    {
+        for (int i = 0; i < T; i++)
+        {
+            solveStream();
+        }
+    }
+    else if (options.batch)
+    {
+        solveBatch(T);
+    }
+    else
+    {
+        for (int i = 0; i < T; i++)
+        {
+            solve();
+        }
+    }
+    if (options.statsPath != NULL)
     {
-        solve();
+        closeStats();
     }
+    delete input;
 }
\ No newline at end of file